@@ -0,0 +1,166 @@
+#include "../include/I2c.hpp"
+#include "../include/I2c_Sim.hpp"
+#include "../include/I2c_Log.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+
+// Hot paths of the static API, on the simulator or on a real i2c-dev bus.
+//
+//   bench_driver [--dev /dev/i2c-1] [--realtime] [--iterations N] [--json]
+//
+// --realtime makes the simulator take as long as a 100 kHz bus would.
+// --json prints one JSON object per line, for comparing versions.
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t syscalls()
+{
+	static I2c_MetricsSnapshot m;
+	uint64_t n = 0;
+
+	I2c::motor_board().metrics().snapshot(m);
+	n += m.syscalls;
+	I2c::servo_board().metrics().snapshot(m);
+	n += m.syscalls;
+	I2c_INA219::device().metrics().snapshot(m);
+	n += m.syscalls;
+	return n;
+}
+
+struct Bench
+{
+	const char *name;
+	std::function<void(int)> prepare;  // untimed, before each call
+	std::function<void(int)> run;
+};
+
+static void report(const char *backend, const Bench &b, int iterations, uint64_t total_ns,
+		   uint64_t calls, const I2c_Histogram &h, bool json)
+{
+	static I2c_HistogramSnapshot s;
+	double ops = total_ns ? iterations * 1e9 / total_ns : 0;
+	double per_op = (double)calls / iterations;
+
+	h.snapshot(s);
+	if (json) {
+		printf("{\"bench\":\"%s\",\"backend\":\"%s\",\"iterations\":%d,\"ops_per_sec\":%.1f,"
+		       "\"syscalls_per_op\":%.3f,\"mean_ns\":%.0f,\"p50_ns\":%lu,\"p99_ns\":%lu,"
+		       "\"p999_ns\":%lu,\"max_ns\":%lu}\n",
+		       b.name, backend, iterations, ops, per_op, s.mean(),
+		       s.percentile(0.5), s.percentile(0.99), s.percentile(0.999), s.max);
+	} else {
+		printf("%-16s %12.0f %10.2f %10lu %10lu %10lu %10lu\n", b.name, ops, per_op,
+		       s.percentile(0.5), s.percentile(0.99), s.percentile(0.999), s.max);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = nullptr;
+	bool realtime = false;
+	bool json = false;
+	int iterations = 10000;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--dev") && i + 1 < argc)
+			dev = argv[++i];
+		else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--realtime"))
+			realtime = true;
+		else if (!strcmp(argv[i], "--json"))
+			json = true;
+		else {
+			fprintf(stderr, "usage: %s [--dev /dev/i2c-N] [--realtime] [--iterations N] [--json]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (iterations <= 0)
+		iterations = 1;
+
+	I2c_SimBus bus;
+	I2c_SimPcA9685 mot;
+	I2c_SimPcA9685 servo;
+	I2c_SimINA219 ina;
+	std::string backend;
+
+	try {
+		if (dev) {
+			I2c::All_init(0x60, 0x40, 0x41, dev);
+			backend = dev;
+		} else {
+			bus.attach(0x60, &mot);
+			bus.attach(0x40, &servo);
+			bus.attach(0x41, &ina);
+			ina.set_inputs(0.05, 11.8);
+			bus.set_realtime(realtime);
+			I2c_PcA9685::init(bus.transport(0x60), bus.transport(0x40));
+			I2c_INA219::init(bus.transport(0x41));
+			backend = realtime ? "sim-realtime" : "sim";
+		}
+	} catch (std::exception &e) {
+		fprintf(stderr, "init failed: %s\n", e.what());
+		return 1;
+	}
+
+	// Alternate between two values so every call reaches the bus instead
+	// of being absorbed by the register cache
+	Bench benches[] = {
+		{"motor", [](int) {}, [](int i) { I2c::motor(0, i & 1 ? 60 : 40, 1); }},
+		{"set_servo_angle", [](int) {}, [](int i) { I2c::set_servo_angle(i & 1 ? 60 : 120); }},
+		{"stop_all", [](int) { I2c::motor(0, 50, 1); }, [](int) { I2c::stop_all(); }},
+		{"emergency_stop", [](int) { I2c::motor(0, 50, 1); }, [](int) { I2c::emergency_stop(); }},
+		{"update_values", [](int) {}, [](int) { I2c::update_values(); }},
+		{"value_batery", [](int) {}, [](int) { I2c::value_batery(); }},
+	};
+
+	if (!json)
+		printf("%-16s %12s %10s %10s %10s %10s %10s   (%s, ns)\n", "bench", "ops/s",
+		       "syscalls", "p50", "p99", "p99.9", "max", backend.c_str());
+
+	// The INA219 paths log every reading; keep that out of the report
+	// but leave the logging cost in the measurement
+	I2c_LogConfig log;
+	log.fd = open("/dev/null", O_WRONLY);
+	I2c_Log::start(log);
+
+	for (const Bench &b : benches) {
+		static I2c_Histogram h;
+		uint64_t total = 0;
+		uint64_t calls = 0;
+
+		h.reset();
+		try {
+			for (int i = 0; i < iterations; ++i) {
+				b.prepare(i);
+				uint64_t before = syscalls();
+				uint64_t t0 = monotonic_ns();
+				b.run(i);
+				uint64_t dt = monotonic_ns() - t0;
+				calls += syscalls() - before;
+				total += dt;
+				h.record(dt);
+			}
+		} catch (std::exception &e) {
+			fprintf(stderr, "%s failed: %s\n", b.name, e.what());
+			continue;
+		}
+		report(backend.c_str(), b, iterations, total, calls, h, json);
+	}
+
+	I2c::stop_all();
+	I2c_Log::stop();
+	close(log.fd);
+	return 0;
+}
@@ -0,0 +1,297 @@
+#include "../include/I2c.hpp"
+#include "../include/I2c_Sim.hpp"
+#include "../include/I2c_Log.hpp"
+#include "../include/I2c_Recorder.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Replays a flight recorder file (see I2c_Recorder) through the drivers on
+// the simulator: the PCA9685 commands as driver calls, the INA219 samples
+// as register contents read back by update_values().
+//
+//   bench_replay FILE [--realtime] [--speed X] [--wire] [--json]
+//                [--mot 0x60] [--servo 0x40] [--ina 0x41]
+//
+// Without --realtime the records are played back to back; with it they
+// keep their recorded spacing (divided by --speed). --wire makes the
+// simulator take as long as a 100 kHz bus would.
+
+enum Kind { MOTOR, SERVO, STOP, ESTOP, BRAKE, SAMPLE, KINDS };
+static const char *kind_names[KINDS] = {"motor", "servo", "stop", "emergency_stop", "brake", "update_values"};
+
+// INA219 that answers with the registers of a recorded sample
+class ReplayINA219 : public I2c_SimDevice
+{
+	private:
+		uint16_t _regs[6];
+		uint8_t _ptr;
+
+	public:
+		ReplayINA219() : _regs(), _ptr(0) {}
+
+		void load(const I2c_RecordSample &s)
+		{
+			_regs[1] = s.raw[0];
+			_regs[2] = s.raw[1];
+			_regs[3] = s.raw[3];
+			_regs[4] = s.raw[2];
+		}
+
+		void write(const uint8_t *data, size_t len) override
+		{
+			if (len == 0)
+				return;
+			_ptr = data[0] < 6 ? data[0] : 0;
+			if (len >= 3 && (_ptr == 0 || _ptr == 5))
+				_regs[_ptr] = (data[1] << 8) | data[2];
+		}
+
+		void read(uint8_t *data, size_t len) override
+		{
+			for (size_t i = 0; i < len; ++i)
+				data[i] = (i & 1) ? (_regs[_ptr] & 0xFF) : (_regs[_ptr] >> 8);
+		}
+};
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / 1000000000ull;
+	ts.tv_nsec = ns % 1000000000ull;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+}
+
+// Runs one record; returns its kind or -1 if it is not replayed
+static int play(const I2c_RecordEntry &e, uint8_t mot, uint8_t servo, uint8_t ina, ReplayINA219 &sensor)
+{
+	int32_t a[4];
+
+	if (e.type == (uint8_t)I2c_RecordType::Sample && e.device == ina) {
+		I2c_RecordSample s;
+		memcpy(&s, e.data, sizeof(s));
+		sensor.load(s);
+		I2c_INA219::update_values();
+		return SAMPLE;
+	}
+	if (e.type != (uint8_t)I2c_RecordType::Command || (e.device != mot && e.device != servo))
+		return -1;
+
+	I2c_PcA9685_Device &board = e.device == mot ? I2c::motor_board() : I2c::servo_board();
+	memcpy(a, e.data, sizeof(a));
+	board.brake_update();
+	switch ((I2c_RecordCommand)e.reg) {
+	case I2c_RecordCommand::Motor:
+		board.motor(a[0], a[1], a[2]);
+		return MOTOR;
+	case I2c_RecordCommand::Servo: {
+		float angle;
+		memcpy(&angle, &a[1], sizeof(angle));
+		board.set_servo_angle(a[0], angle);
+		return SERVO;
+	}
+	case I2c_RecordCommand::StopMotors:
+		board.stop_motors();
+		return STOP;
+	case I2c_RecordCommand::StopAll:
+		board.stop_all();
+		return STOP;
+	case I2c_RecordCommand::EmergencyStop:
+		board.emergency_stop();
+		return ESTOP;
+	case I2c_RecordCommand::Brake: {
+		I2c_BrakeProfile p;
+		p.mode = (I2c_BrakeMode)a[0];
+		p.duration_us = a[1];
+		p.intensity = a[2];
+		p.pulse_us = a[3];
+		board.brake_motor(p);
+		return BRAKE;
+	}
+	}
+	return -1;
+}
+
+static uint64_t transactions()
+{
+	static I2c_MetricsSnapshot m;
+	uint64_t n = 0;
+
+	I2c::motor_board().metrics().snapshot(m);
+	n += m.transactions();
+	I2c::servo_board().metrics().snapshot(m);
+	n += m.transactions();
+	I2c_INA219::device().metrics().snapshot(m);
+	n += m.transactions();
+	return n;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = nullptr;
+	bool realtime = false;
+	bool wire = false;
+	bool json = false;
+	double speed = 1;
+	uint8_t mot = 0x60;
+	uint8_t servo = 0x40;
+	uint8_t ina = 0x41;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--realtime"))
+			realtime = true;
+		else if (!strcmp(argv[i], "--wire"))
+			wire = true;
+		else if (!strcmp(argv[i], "--json"))
+			json = true;
+		else if (!strcmp(argv[i], "--speed") && i + 1 < argc)
+			speed = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--mot") && i + 1 < argc)
+			mot = strtol(argv[++i], nullptr, 0);
+		else if (!strcmp(argv[i], "--servo") && i + 1 < argc)
+			servo = strtol(argv[++i], nullptr, 0);
+		else if (!strcmp(argv[i], "--ina") && i + 1 < argc)
+			ina = strtol(argv[++i], nullptr, 0);
+		else if (argv[i][0] != '-' && !path)
+			path = argv[i];
+		else
+			path = nullptr, i = argc;
+	}
+	if (!path || speed <= 0) {
+		fprintf(stderr, "usage: %s FILE [--realtime] [--speed X] [--wire] [--json] "
+			"[--mot 0x60] [--servo 0x40] [--ina 0x41]\n", argv[0]);
+		return 2;
+	}
+
+	std::vector<I2c_RecordEntry> records;
+	uint64_t recorded_traffic = 0;
+
+	if (!I2c_Recorder::load(path, records)) {
+		fprintf(stderr, "%s: not a recorder file\n", path);
+		return 1;
+	}
+	// Transactions after the first command or sample (init is not replayed);
+	// the records of one transaction share its device and start time
+	bool playing = false;
+	const I2c_RecordEntry *last = nullptr;
+	for (const I2c_RecordEntry &e : records) {
+		if (e.type == (uint8_t)I2c_RecordType::Command || e.type == (uint8_t)I2c_RecordType::Sample)
+			playing = true;
+		if (!playing || (e.type != (uint8_t)I2c_RecordType::Write && e.type != (uint8_t)I2c_RecordType::Read)
+		    || (e.device != mot && e.device != servo && e.device != ina))
+			continue;
+		if (!last || last->device != e.device || last->timestamp_ns != e.timestamp_ns)
+			recorded_traffic++;
+		last = &e;
+	}
+
+	I2c_SimBus bus;
+	I2c_SimPcA9685 mot_sim;
+	I2c_SimPcA9685 servo_sim;
+	ReplayINA219 ina_sim;
+
+	bus.attach(0x60, &mot_sim);
+	bus.attach(0x40, &servo_sim);
+	bus.attach(0x41, &ina_sim);
+	bus.set_realtime(wire);
+
+	// update_values() logs every sample: keep the cost, not the output
+	I2c_LogConfig log;
+	log.fd = open("/dev/null", O_WRONLY);
+	I2c_Log::start(log);
+
+	try {
+		I2c_PcA9685::init(bus.transport(0x60), bus.transport(0x40));
+		I2c_INA219::init(bus.transport(0x41));
+	} catch (std::exception &e) {
+		fprintf(stderr, "init failed: %s\n", e.what());
+		return 1;
+	}
+
+	static I2c_Histogram latency[KINDS];
+	static I2c_Histogram lag;   // how late each record started, --realtime only
+	uint64_t errors = 0;
+	uint64_t played = 0;
+	uint64_t before = transactions();
+	uint64_t first_ts = records.empty() ? 0 : records[0].timestamp_ns;
+	uint64_t start = monotonic_ns();
+
+	for (const I2c_RecordEntry &e : records) {
+		uint64_t due = 0;
+
+		if (realtime) {
+			due = start + (uint64_t)((e.timestamp_ns - first_ts) / speed);
+			if (monotonic_ns() < due)
+				sleep_until(due);
+		}
+		uint64_t t0 = monotonic_ns();
+		if (realtime)
+			lag.record(t0 > due ? t0 - due : 0);
+		int kind;
+		try {
+			kind = play(e, mot, servo, ina, ina_sim);
+		} catch (std::exception &ex) {
+			errors++;
+			continue;
+		}
+		if (kind < 0)
+			continue;
+		latency[kind].record(monotonic_ns() - t0);
+		played++;
+	}
+
+	uint64_t total = monotonic_ns() - start;
+	uint64_t traffic = transactions() - before;
+	double span = records.empty() ? 0 : (records.back().timestamp_ns - first_ts) * 1e-9;
+	double rate = total ? played * 1e9 / total : 0;
+	I2c_HistogramSnapshot s;
+
+	if (json) {
+		printf("{\"file\":\"%s\",\"records\":%zu,\"played\":%lu,\"errors\":%lu,\"seconds\":%.6f,"
+		       "\"recorded_seconds\":%.6f,\"commands_per_sec\":%.1f,\"transactions\":%lu,"
+		       "\"recorded_transactions\":%lu", path, records.size(), played, errors, total * 1e-9,
+		       span, rate, traffic, recorded_traffic);
+		for (int k = 0; k < KINDS; ++k) {
+			latency[k].snapshot(s);
+			if (s.count)
+				printf(",\"%s\":{\"count\":%lu,\"p50_ns\":%lu,\"p99_ns\":%lu,\"p999_ns\":%lu,\"max_ns\":%lu}",
+				       kind_names[k], s.count, s.percentile(0.5), s.percentile(0.99),
+				       s.percentile(0.999), s.max);
+		}
+		lag.snapshot(s);
+		printf(",\"lag_p99_ns\":%lu}\n", s.count ? s.percentile(0.99) : 0);
+	} else {
+		printf("%s: %zu records (%.3f s recorded), %lu played in %.3f s, %.0f commands/s, %lu errors\n",
+		       path, records.size(), span, played, total * 1e-9, rate, errors);
+		printf("bus transactions: %lu replayed, %lu recorded\n", traffic, recorded_traffic);
+		printf("%-16s %10s %10s %10s %10s %10s   (ns)\n", "command", "count", "p50", "p99", "p99.9", "max");
+		for (int k = 0; k < KINDS; ++k) {
+			latency[k].snapshot(s);
+			if (s.count)
+				printf("%-16s %10lu %10lu %10lu %10lu %10lu\n", kind_names[k], s.count,
+				       s.percentile(0.5), s.percentile(0.99), s.percentile(0.999), s.max);
+		}
+		lag.snapshot(s);
+		if (realtime)
+			printf("start lag: p50 %lu ns, p99 %lu ns, max %lu ns\n", s.count ? s.percentile(0.5) : 0,
+			       s.count ? s.percentile(0.99) : 0, s.max);
+	}
+
+	I2c_PcA9685::stop_all();
+	I2c_Log::stop();
+	close(log.fd);
+	return errors ? 1 : 0;
+}
@@ -1,3 +1,4 @@
+#pragma once
 #include "I2c_PcA9685.hpp"
 #include "I2c_INA219.hpp"
 
@@ -9,7 +10,8 @@ class I2c: public I2c_PcA9685 , public I2c_INA219
 {
 	
 	public:
-		static void All_init();
+		static void All_init(uint8_t addr_mot = 0x60, uint8_t addr_servo = 0x40,
+				     uint8_t addr_ina = 0x41, std::string i2c_device = "/dev/i2c-1");
 		static void All_close();
 
 
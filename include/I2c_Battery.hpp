@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+// Open-circuit voltage points of the pack, from empty to full in equal
+// state-of-charge steps
+#define I2C_BATTERY_OCV_POINTS 11
+
+// Battery model. Defaults: the car's 3S 18650 pack.
+struct I2c_BatteryConfig
+{
+	double capacity_mah = 2600;
+	double resistance_ohm = 0.15;     // pack internal resistance
+	// Pack OCV at 0, 10, ... 100 %, V (typical Li-ion cell curve x 3)
+	double ocv[I2C_BATTERY_OCV_POINTS] = {
+		9.90, 10.50, 10.80, 10.98, 11.16, 11.31, 11.46, 11.64, 11.88, 12.18, 12.60,
+	};
+	// Filter tuning: drift of the coulomb count (state-of-charge variance
+	// added per second) and noise of the OCV seen through the voltage
+	// reading, at rest and per ampere of load
+	double drift_per_s = 1e-7;
+	double voltage_noise_v = 0.05;
+	double load_noise_v_per_a = 0.2;
+	double initial_std = 0.1;         // uncertainty of the first OCV guess
+};
+
+// Estimate after the last sample
+struct I2c_BatteryState
+{
+	uint64_t timestamp_ns;   // of the last sample, 0 before the first one
+	uint64_t samples;
+	double soc;              // state of charge, 0..1
+	double soc_std;          // its standard deviation
+	double used_mah;         // charge drawn since the first sample (negative when charging)
+	double ocv;              // V, reading corrected for the load current
+	double current;          // mA, positive when discharging
+
+	int percent() const { return (int)(soc * 100 + 0.5); }
+};
+
+// State of charge from coulomb counting fused with the OCV curve by a
+// one-state Kalman filter. Counting the current tracks load changes that
+// make the bus voltage jump; the voltage slowly pulls the count back where
+// the curve is steep and the load light. O(1) per sample, no I/O.
+class I2c_BatteryEstimator
+{
+	private:
+		I2c_BatteryConfig _config;
+		I2c_BatteryState _state;
+		double _variance;
+		bool _seeded;     // false until reset() or the first sample
+
+		double ocv(double soc, double *slope) const;
+		double soc_from_ocv(double voltage) const;
+
+	public:
+		explicit I2c_BatteryEstimator(const I2c_BatteryConfig &config = I2c_BatteryConfig());
+
+		// Restarts from the next sample's OCV
+		void configure(const I2c_BatteryConfig &config);
+		const I2c_BatteryConfig &config() const { return _config; }
+		// For a pack known to be full (or at another charge) right now
+		void reset(double soc, double soc_std = 0.01);
+
+		// voltage: bus V, current: mA through the shunt
+		void update(uint64_t timestamp_ns, double voltage, double current);
+		const I2c_BatteryState &state() const { return _state; }
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "I2c_PcA9685.hpp"
+#include "I2c_Queue.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+enum class I2c_CommandType : uint8_t
+{
+	Motor,
+	Servo,
+	StopMotors,
+	StopAll,
+	Brake,
+	Fence,
+};
+
+// One request for the bus owner thread
+struct I2c_Command
+{
+	I2c_CommandType type;
+	int mot;
+	int speed;
+	bool dir;
+	float angle;
+	I2c_BrakeProfile brake;
+	std::atomic<bool> *done;  // Fence: set once every earlier command ran
+};
+
+// Single owner of a motor board and a servo board. Any thread may queue
+// commands; only the executor thread touches the boards, so callers never
+// contend on the bus or on the drivers' state.
+class I2c_Executor
+{
+	private:
+		std::unique_ptr<I2c_PcA9685_Device> _mot;
+		std::unique_ptr<I2c_PcA9685_Device> _servo;
+		I2c_MpscQueue<I2c_Command, 64> _queue;
+		std::thread _thread;
+		std::atomic<bool> _run;
+		std::atomic<bool> _sleeping;
+		std::atomic<bool> _estop;
+		std::atomic<uint64_t> _dropped;
+		std::atomic<uint64_t> _errors;
+		std::atomic<I2c_Watchdog *> _watchdog;
+		int _wake_fd;
+
+		void loop();
+		I2c_Status execute(const I2c_Command &cmd);
+		bool submit(const I2c_Command &cmd);
+		void wake();
+		void service_estop();
+		void discard(const I2c_Command &cmd);
+		void failed(int command);
+
+	public:
+		// Takes over the boards: they are initialized here and the motors
+		// stopped by the destructor
+		I2c_Executor(std::unique_ptr<I2c_Transport> mot, std::unique_ptr<I2c_Transport> servo);
+		I2c_Executor(uint8_t addr_mot, uint8_t addr_servo, const std::string &i2c_device);
+		~I2c_Executor();
+		I2c_Executor(const I2c_Executor &) = delete;
+		I2c_Executor &operator=(const I2c_Executor &) = delete;
+
+		// Non-blocking; false if the queue was full and the command dropped
+		bool motor(int mot, int speed, bool dir);
+		bool set_servo_angle(float angle);
+		bool stop_motors();
+		bool stop_all();
+		// The brake is released by the executor thread after the profile's
+		// duration; a later motor or stop command cancels it
+		bool brake_motor(const I2c_BrakeProfile &profile = I2c_BrakeProfile());
+
+		// Jumps the queue: runs before any pending command, and the commands
+		// still queued then are dropped. The stop is one ALL_LED write per board.
+		void emergency_stop();
+
+		// Every queued motor() then counts as a heartbeat; nullptr detaches it
+		void watch(I2c_Watchdog *watchdog) { _watchdog.store(watchdog, std::memory_order_release); }
+
+		// Blocks until every command queued before the call has run
+		void sync();
+
+		uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+		uint64_t errors() const { return _errors.load(std::memory_order_relaxed); }
+		const I2c_Metrics &motor_metrics() const { return _mot->metrics(); }
+		const I2c_Metrics &servo_metrics() const { return _servo->metrics(); }
+		// For I2c_Watchdog::stop_board(); only the executor thread may drive it
+		I2c_PcA9685_Device &motor_board() { return *_mot; }
+};
@@ -1,3 +1,4 @@
+#pragma once
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -8,7 +9,188 @@
 
 
 #include <cstdint>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "I2c_Transport.hpp"
+#include "I2c_Seqlock.hpp"
+#include "I2c_Telemetry.hpp"
+#include "I2c_Battery.hpp"
+#include "I2c_Result.hpp"
 
+// Samples kept in the INA219 history ring (power of two)
+#define I2C_INA219_HISTORY 1024
+
+// ===== Configuration register fields =====
+
+enum class I2c_INA219_BusRange : uint8_t { V16 = 0, V32 = 1 };
+
+// PGA: full-scale shunt voltage
+enum class I2c_INA219_Gain : uint8_t { mV40 = 0, mV80 = 1, mV160 = 2, mV320 = 3 };
+
+// ADC resolution or number of 12-bit samples averaged
+enum class I2c_INA219_Adc : uint8_t
+{
+	Bits9 = 0x0, Bits10 = 0x1, Bits11 = 0x2, Bits12 = 0x3,
+	Avg2 = 0x9, Avg4 = 0xA, Avg8 = 0xB, Avg16 = 0xC, Avg32 = 0xD, Avg64 = 0xE, Avg128 = 0xF
+};
+
+enum class I2c_INA219_Mode : uint8_t
+{
+	PowerDown = 0, ShuntTriggered = 1, BusTriggered = 2, ShuntBusTriggered = 3,
+	AdcOff = 4, ShuntContinuous = 5, BusContinuous = 6, ShuntBusContinuous = 7
+};
+
+// Defaults give the historical 0x19FF / 4096 setup (0.1 mA/bit with the
+// board's 0.1 ohm shunt)
+struct I2c_INA219_Config
+{
+	I2c_INA219_BusRange bus_range = I2c_INA219_BusRange::V16;
+	I2c_INA219_Gain gain = I2c_INA219_Gain::mV320;
+	I2c_INA219_Adc bus_adc = I2c_INA219_Adc::Bits12;
+	I2c_INA219_Adc shunt_adc = I2c_INA219_Adc::Avg128;
+	I2c_INA219_Mode mode = I2c_INA219_Mode::ShuntBusContinuous;
+	uint16_t calibration = 4096;
+	uint32_t shunt_uohm = 100000;     // shunt resistor, micro-ohm
+
+	uint16_t reg() const;             // value of the config register
+	uint32_t conversion_us() const;   // time of one full conversion cycle
+	bool triggered() const;
+
+	// Sets shunt, calibration and the smallest PGA range that covers
+	// max_current_ma; throws if the combination does not fit the chip
+	void calibrate(uint32_t shunt_uohm, uint32_t max_current_ma);
+	// Current register LSB in pA (power LSB is 20 times it, in pW)
+	uint64_t current_lsb_pa() const;
+};
+
+// Raw register contents of one INA219 sample
+struct I2c_INA219_Raw
+{
+	uint16_t shunt;
+	uint16_t bus;
+	uint16_t current;
+	uint16_t power;
+
+	bool ready() const { return bus & 0x0002; }     // CNVR
+	bool overflow() const { return bus & 0x0001; }  // OVF
+};
+
+// One converted INA219 reading. The integer fields are the exact result;
+// the floating point ones are the same values in the historical units.
+struct I2c_INA219_Sample
+{
+	uint64_t timestamp_ns;   // CLOCK_MONOTONIC
+	int32_t bus_uv;
+	int32_t shunt_uv;
+	int32_t current_ua;
+	uint32_t power_uw;
+	double voltage;          // V (bus)
+	double shunt_voltage;    // V
+	double current;          // mA
+	double power;            // mW
+	I2c_INA219_Raw raw;
+};
+
+// Window statistics of the published samples
+struct I2c_INA219_Stats
+{
+	I2c_Stats voltage;
+	I2c_Stats current;
+	I2c_Stats power;
+};
+
+// One INA219: its own transport, configuration, sampler and history.
+// Create as many as there are sensors, on any bus and address.
+class I2c_INA219_Device
+{
+	private:
+		std::unique_ptr<I2c_Transport> _bus;
+		I2c_INA219_Config _config;
+		uint64_t _current_lsb_pa;
+	 	void writeRegister(uint8_t reg, uint16_t value);
+		uint16_t readRegister(uint8_t reg);
+		int readRegisters(const uint8_t *regs, uint16_t *values, size_t count) noexcept;
+		void convert(const I2c_INA219_Raw &raw, I2c_INA219_Sample &out) const;
+
+		std::thread _sampler;
+		std::atomic<bool> _sampler_run;
+		std::atomic<uint32_t> _sampler_errors;
+		double _sampler_rate;
+		std::atomic<uint64_t> _ready_ns;   // last sample update_if_ready() returned
+		I2c_Seqlock<I2c_INA219_Sample> _snapshot;
+		void sampler_loop(double rate_hz);
+		void publish(const I2c_INA219_Sample &s);
+
+		I2c_RingBuffer<I2c_INA219_Sample, I2C_INA219_HISTORY> _history;
+		I2c_WindowStats<I2C_INA219_HISTORY> _stats_voltage;
+		I2c_WindowStats<I2C_INA219_HISTORY> _stats_current;
+		I2c_WindowStats<I2C_INA219_HISTORY> _stats_power;
+		I2c_Seqlock<I2c_INA219_Stats> _stats;
+		I2c_BatteryEstimator _battery;
+		I2c_Seqlock<I2c_BatteryState> _battery_state;
+
+	public:
+		explicit I2c_INA219_Device(std::unique_ptr<I2c_Transport> bus);
+		I2c_INA219_Device(const std::string &i2c_device, uint8_t addr);
+		~I2c_INA219_Device();
+		I2c_INA219_Device(const I2c_INA219_Device &) = delete;
+		I2c_INA219_Device &operator=(const I2c_INA219_Device &) = delete;
+
+		void init(const I2c_INA219_Config &config = I2c_INA219_Config());
+		// Pauses the sampler, if running, while the scales change
+		void configure(const I2c_INA219_Config &config);
+		const I2c_INA219_Config &config() const;
+
+		void read_raw(I2c_INA219_Raw &raw);
+		// Fetches the sample only if a new conversion finished (CNVR),
+		// returns false otherwise without reading the other registers
+		bool read_raw_if_ready(I2c_INA219_Raw &raw);
+		void sample(I2c_INA219_Sample &out);
+		bool sample_if_ready(I2c_INA219_Sample &out);
+		I2c_INA219_Sample update();
+		bool update_if_ready(I2c_INA219_Sample &out);
+		I2c_INA219_Sample latest();
+		// Non-throwing read_raw(), sample() and update(); transient bus
+		// errors are retried by the transport (see I2c_RetryPolicy)
+		I2c_Status try_read_raw(I2c_INA219_Raw &raw) noexcept;
+		I2c_Result<I2c_INA219_Sample> try_sample() noexcept;
+		I2c_Result<I2c_INA219_Sample> try_update() noexcept;
+		int value_batery();
+		static int battery_percent(double voltage);
+
+		// Optional background polling; latest(), update(), try_update()
+		// and update_if_ready() then return the last published sample
+		// instead of reading the bus
+		void start_sampler(double rate_hz);
+		void stop_sampler();
+		bool sampler_running() const;
+		I2c_INA219_Sample snapshot() const;
+		uint32_t sampler_errors() const;
+
+		// Last I2C_INA219_HISTORY - 1 samples, viewed in place (oldest
+		// first). Check history_overwritten() with the returned sequence
+		// number once done reading if the sampler is running: false means
+		// every sample read from the view was intact.
+		uint64_t history(I2c_Span<I2c_INA219_Sample> &first, I2c_Span<I2c_INA219_Sample> &second) const;
+		bool history_overwritten(uint64_t seq) const;
+		void configure_stats(size_t window, double ewma_alpha);
+		I2c_INA219_Stats stats() const;
+
+		// State of charge, updated with every published sample. battery()
+		// only reads the last estimate: no bus I/O. Configure and reset it
+		// while the sampler is stopped.
+		void configure_battery(const I2c_BatteryConfig &config);
+		void reset_battery(double soc, double soc_std = 0.01);
+		I2c_BatteryState battery() const;
+
+		// Bus transactions of this sensor (see I2c_Metrics.hpp)
+		const I2c_Metrics &metrics() const { return _bus->metrics(); }
+		// Register traffic and published samples go to recorder, tagged device
+		void set_recorder(I2c_Recorder *recorder, uint8_t device) { _bus->set_recorder(recorder, device); }
+};
+
+// The car's battery sensor behind the historical static API
 class I2c_INA219
 {
 	protected:
@@ -16,18 +198,37 @@ class I2c_INA219
 		static double _Current; // Ampere
 		static double _Power;    // watt
 		static uint8_t _addr;
-		static int fd;
 		static int status;
 		static std::string _i2c_device;
-	 	static void writeRegister(int fd, uint8_t reg, uint16_t value);
-		static uint16_t readRegister(int fd, uint8_t reg);
+		static std::unique_ptr<I2c_INA219_Device> _dev;
+		static I2c_INA219_Sample latest();
 	public: 
 		static void init( uint8_t addr_servo, std::string i2c_device );
+		static void init(std::unique_ptr<I2c_Transport> bus,
+				 const I2c_INA219_Config &config = I2c_INA219_Config());
+		static void configure(const I2c_INA219_Config &config);
+		static const I2c_INA219_Config &config();
 		static void update_values();
+		static I2c_Status try_update_values() noexcept;
+		static void read_raw(I2c_INA219_Raw &raw);
+		static bool read_raw_if_ready(I2c_INA219_Raw &raw);
+		static bool update_if_ready();
 		static void print();
 		static void close_();
 		static int  value_batery();
-};
-
 
+		// value_batery() and print() use the sampler's last sample while it runs
+		static void start_sampler(double rate_hz);
+		static void stop_sampler();
+		static I2c_INA219_Sample snapshot();
+		static uint32_t sampler_errors();
 
+		static uint64_t history(I2c_Span<I2c_INA219_Sample> &first, I2c_Span<I2c_INA219_Sample> &second);
+		static bool history_overwritten(uint64_t seq);
+		static void configure_stats(size_t window, double ewma_alpha);
+		static I2c_INA219_Stats stats();
+		static void configure_battery(const I2c_BatteryConfig &config);
+		static void reset_battery(double soc, double soc_std = 0.01);
+		static I2c_BatteryState battery();
+		static I2c_INA219_Device &device();
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "I2c_Queue.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+// Records waiting for the writer (power of two); more are dropped
+#define I2C_LOG_CAPACITY 1024
+#define I2C_LOG_ARGS 4
+
+enum class I2c_LogLevel : uint8_t { Debug = 0, Info, Warn, Error, Off };
+
+// What a record says. The arguments of each event are listed next to it;
+// the writer turns them into text (see I2c_Log::format()).
+enum class I2c_LogEvent : uint16_t
+{
+	Message = 0,          // code
+	Ina219Sample,         // bus raw, bus V, shunt V
+	Ina219ReadFailed,     // I2c_Error
+	Ina219Report,         // bus V, current mA, power mW, battery %
+	Ina219SamplerError,   // errors so far
+	Ina219OpenFailed,     // -
+	WatchdogTrip,         // reaction ns, trips so far
+	ExecutorError,        // I2c_CommandType (-1: emergency stop), errors so far
+	Count
+};
+
+// Fixed-size binary record, written as is by the binary format after an
+// I2C_LOG_MAGIC header
+struct I2c_LogRecord
+{
+	uint64_t timestamp_ns;   // CLOCK_MONOTONIC
+	uint16_t event;          // I2c_LogEvent
+	uint8_t level;           // I2c_LogLevel
+	uint8_t nargs;
+	uint32_t thread;         // kernel thread id of the caller
+	double args[I2C_LOG_ARGS];
+};
+
+#define I2C_LOG_MAGIC "I2CLOG1\n"
+
+enum class I2c_LogFormat : uint8_t { Text, Binary };
+
+struct I2c_LogConfig
+{
+	int fd = 1;                        // stdout
+	I2c_LogFormat format = I2c_LogFormat::Text;
+	I2c_LogLevel level = I2c_LogLevel::Info;
+	uint32_t flush_ms = 20;            // writer wake-up period
+};
+
+// Process-wide log sink. log() is lock-free and never blocks: the record
+// goes into a bounded ring and a background thread formats and writes
+// batches with one write() each. Records below the level are filtered
+// before any work; when the ring is full they are dropped and counted.
+// The writer starts with the defaults on the first record if start() was
+// not called, and drains what is left at exit.
+class I2c_Log
+{
+	private:
+		static std::atomic<uint8_t> _level;
+		static std::atomic<bool> _started;
+		static std::atomic<bool> _run;
+		static std::atomic<uint64_t> _dropped;
+		static std::atomic<uint64_t> _written;
+		static I2c_MpscQueue<I2c_LogRecord, I2C_LOG_CAPACITY> _queue;
+		static I2c_LogConfig _config;
+		static std::thread _writer;
+
+		static void start_locked(const I2c_LogConfig &config);
+		static void stop_locked();
+		static void loop();
+		static size_t drain(char *buf, size_t cap);
+
+	public:
+		static bool enabled(I2c_LogLevel level)
+		{
+			return (uint8_t)level >= _level.load(std::memory_order_relaxed);
+		}
+		static void log(I2c_LogLevel level, I2c_LogEvent event, size_t nargs = 0,
+				double a0 = 0, double a1 = 0, double a2 = 0, double a3 = 0);
+
+		static void set_level(I2c_LogLevel level);
+		static I2c_LogLevel level();
+
+		// Restarts the writer with config; stop() drains and joins it
+		static void start(const I2c_LogConfig &config = I2c_LogConfig());
+		static void stop();
+
+		static uint64_t dropped() { return _dropped.load(std::memory_order_relaxed); }
+		static uint64_t written() { return _written.load(std::memory_order_relaxed); }
+
+		// Text of one record (no newline at the end of the last line);
+		// returns its length, truncated to cap - 1
+		static size_t format(const I2c_LogRecord &r, char *buf, size_t cap);
+		static const char *level_name(I2c_LogLevel level);
+		static const char *event_name(I2c_LogEvent event);
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "I2c_Telemetry.hpp"
+#include <atomic>
+#include <cstdint>
+
+// What a transaction was for, as tagged by the driver that sent it
+enum I2c_Op
+{
+	I2C_OP_OTHER,           // untagged transport use
+	I2C_OP_WRITE_BYTE,      // PCA9685 mode/prescaler registers
+	I2C_OP_SET_PWM,         // PCA9685 LED register bursts
+	I2C_OP_READ_BLOCK,      // PCA9685 read-back
+	I2C_OP_WRITE_REGISTER,  // INA219
+	I2C_OP_READ_REGISTER,   // INA219, one or more registers
+	I2C_OP_EMERGENCY_STOP,  // PCA9685 ALL_LED full-off write
+	I2C_OP_COUNT
+};
+
+inline const char *I2c_op_name(int op)
+{
+	static const char *names[I2C_OP_COUNT] = {
+		"other", "write_byte", "set_pwm", "read_block", "write_register", "read_register",
+		"emergency_stop",
+	};
+	return op >= 0 && op < I2C_OP_COUNT ? names[op] : "?";
+}
+
+struct I2c_OpSnapshot
+{
+	uint64_t count;   // transactions, failed ones included
+	uint64_t errors;
+	uint64_t bytes;   // payload bytes of the successful ones
+	I2c_HistogramSnapshot latency;  // ns
+};
+
+struct I2c_MetricsSnapshot
+{
+	I2c_OpSnapshot ops[I2C_OP_COUNT];
+	uint64_t syscalls;
+	uint64_t retries;
+
+	uint64_t transactions() const
+	{
+		uint64_t n = 0;
+		for (int i = 0; i < I2C_OP_COUNT; ++i)
+			n += ops[i].count;
+		return n;
+	}
+
+	// Time spent inside the transport, in ns
+	uint64_t busy_ns() const
+	{
+		uint64_t ns = 0;
+		for (int i = 0; i < I2C_OP_COUNT; ++i)
+			ns += ops[i].latency.sum;
+		return ns;
+	}
+};
+
+// Counters and latency histograms of one transport, per operation.
+// Updated with relaxed atomics, so any thread may take a snapshot while
+// the owner keeps using the bus.
+class I2c_Metrics
+{
+	private:
+		struct Op
+		{
+			std::atomic<uint64_t> errors;
+			std::atomic<uint64_t> bytes;
+			I2c_Histogram latency;
+		};
+
+		Op _ops[I2C_OP_COUNT];
+		std::atomic<uint64_t> _syscalls;
+		std::atomic<uint64_t> _retries;
+
+	public:
+		I2c_Metrics() { reset(); }
+
+		void record(int op, uint64_t ns, uint64_t bytes, bool ok)
+		{
+			Op &o = _ops[op];
+
+			o.latency.record(ns);
+			if (ok)
+				o.bytes.fetch_add(bytes, std::memory_order_relaxed);
+			else
+				o.errors.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void count_syscalls(uint64_t n) { _syscalls.fetch_add(n, std::memory_order_relaxed); }
+		void count_retry() { _retries.fetch_add(1, std::memory_order_relaxed); }
+
+		void snapshot(I2c_MetricsSnapshot &out) const
+		{
+			for (int i = 0; i < I2C_OP_COUNT; ++i) {
+				_ops[i].latency.snapshot(out.ops[i].latency);
+				out.ops[i].count = out.ops[i].latency.count;
+				out.ops[i].errors = _ops[i].errors.load(std::memory_order_relaxed);
+				out.ops[i].bytes = _ops[i].bytes.load(std::memory_order_relaxed);
+			}
+			out.syscalls = _syscalls.load(std::memory_order_relaxed);
+			out.retries = _retries.load(std::memory_order_relaxed);
+		}
+
+		void reset()
+		{
+			for (int i = 0; i < I2C_OP_COUNT; ++i) {
+				_ops[i].errors.store(0, std::memory_order_relaxed);
+				_ops[i].bytes.store(0, std::memory_order_relaxed);
+				_ops[i].latency.reset();
+			}
+			_syscalls.store(0, std::memory_order_relaxed);
+			_retries.store(0, std::memory_order_relaxed);
+		}
+};
@@ -1,3 +1,4 @@
+#pragma once
 
 #include <cstdint>
 #include <fcntl.h>
@@ -6,31 +7,157 @@
 #include <linux/i2c-dev.h>
 #include <iostream>
 #include <cstdint>
+#include <memory>
+#include <atomic>
+#include "I2c_Transport.hpp"
+#include "I2c_PwmProfile.hpp"
+#include "I2c_Result.hpp"
+#include "I2c_Recorder.hpp"
 
+// In-memory copy of the 16 LED registers of one board
+struct I2c_PcA9685_Shadow
+{
+	uint16_t on[16];
+	uint16_t off[16];
+	uint16_t valid;  // channels known to match the chip
+	uint16_t dirty;  // channels changed since the last flush
+};
 
-class I2c_PcA9685
+enum class I2c_BrakeMode : uint8_t
+{
+	Constant,      // intensity for the whole duration
+	Pulsed,        // intensity and release alternating every pulse_us
+	Proportional,  // from intensity down to 0, lowered every pulse_us
+};
+
+// How brake_motor() brakes; the motors coast once duration_us is over
+struct I2c_BrakeProfile
+{
+	I2c_BrakeMode mode = I2c_BrakeMode::Constant;
+	uint32_t duration_us = 100000;
+	int intensity = 100;       // percent of full brake, clamped to 0..100
+	uint32_t pulse_us = 10000;
+};
+
+// One PCA9685 board: its own transport, register shadow and servo setup.
+// Create as many as there are boards, on any bus and address.
+class I2c_PcA9685_Device
 {
 	private:
-		static int _fd_mot;
-		static int _fd_servo;
-		static int _fd_set;
-		static float _SERVO_MIN_PULSE_MS;  // ms (0°)
-		static float _SERVO_MAX_PULSE_MS;  // ms (180°)
+		std::unique_ptr<I2c_Transport> _bus;
+		I2c_PcA9685_Shadow _shadow;
+		uint64_t _wake_ns;  // oscillator start, see init_begin()
+		I2c_BrakeProfile _brake;
+		uint64_t _brake_start;
+		bool _braking;
+		std::atomic<bool> _stale;  // see invalidate_cache_async()
+		void apply_brake(int percent);
 		static float _SERVO_FREQ;   
-		static std::string _i2c_device;
-		static void write_byte(uint8_t reg, uint8_t val);
-		static void set_pwm(uint8_t channel, uint16_t on, uint16_t off);
-		static void set_pwm_duty(uint8_t channel, float duty_fraction);
+		void stage_pwm(uint8_t channel, uint16_t on, uint16_t off);
+		int flush() noexcept;
+		int update_pwm(uint8_t channel, const uint16_t *on, const uint16_t *off, uint8_t count) noexcept;
+		int write_pwm_burst(uint8_t channel, const uint16_t *on, const uint16_t *off, uint8_t count) noexcept;
+		void write_byte(uint8_t reg, uint8_t val);
+		int write_block(uint8_t reg, const uint8_t *data, size_t len) noexcept;
+		void read_block(uint8_t reg, uint8_t *data, size_t len);
+		bool configured(uint8_t prescaler);
+		void record(I2c_RecordCommand cmd, int32_t a0 = 0, int32_t a1 = 0, int32_t a2 = 0,
+			    int32_t a3 = 0) noexcept;
+
+	public:
+		explicit I2c_PcA9685_Device(std::unique_ptr<I2c_Transport> bus);
+		I2c_PcA9685_Device(const std::string &i2c_device, uint8_t addr);
+
+		void init(uint8_t prescaler = 121);
+		void init_begin(uint8_t prescaler = 121);
+		void init_finish();
+		bool resume(uint8_t prescaler = 121);
+		bool warm_init(uint8_t prescaler = 121);
+		void set_pwm(uint8_t channel, uint16_t on, uint16_t off);
+		void set_pwm_burst(uint8_t channel, const uint16_t *on, const uint16_t *off, uint8_t count);
+		void set_pwm_duty(uint8_t channel, float duty_fraction);
+		void set_pwm_percent(uint8_t channel, int percent);
+		void stop_all();
+		void stop_motors();
+		void emergency_stop();
+		static int emergency_stop(I2c_Transport &bus);
+		void motor(int mot,int speed,bool dir);
+		void set_servo_angle(uint8_t channel, float angle);
+		// Servo described by an I2c_ServoProfile other than the default
+		template <class Profile>
+		void set_servo_angle(uint8_t channel, float angle) { set_pwm(channel, 0, Profile::ticks(angle)); }
+		// Non-blocking: call brake_update() (or let I2c_Executor do it) until
+		// it returns 0. motor(), stop_motors() and stop_all() cancel it.
+		void brake_motor(const I2c_BrakeProfile &profile = I2c_BrakeProfile());
+		uint64_t brake_update();
+		void brake_cancel();
+		bool braking() const { return _braking; }
+		void invalidate_cache();
+		void invalidate_cache_async();
+
+		// The same commands without exceptions: failures come back as an
+		// error code, after the transport's retries (see I2c_RetryPolicy).
+		// Channels that failed to write stay pending, so calling again
+		// resends them.
+		I2c_Status try_set_pwm_burst(uint8_t channel, const uint16_t *on, const uint16_t *off, uint8_t count) noexcept;
+		I2c_Status try_motor(int mot, int speed, bool dir) noexcept;
+		I2c_Status try_set_servo_angle(uint8_t channel, float angle) noexcept;
+		I2c_Status try_stop_motors() noexcept;
+		I2c_Status try_stop_all() noexcept;
+		I2c_Status try_emergency_stop() noexcept;
+
+		// Bus transactions of this board (see I2c_Metrics.hpp)
+		const I2c_Metrics &metrics() const { return _bus->metrics(); }
+		// Commands and register writes go to recorder, tagged device
+		void set_recorder(I2c_Recorder *recorder, uint8_t device) { _bus->set_recorder(recorder, device); }
+
+		static uint16_t duty_to_pwm(float duty_fraction);
 		static uint16_t ms_to_pwm(float ms);
-    		static uint16_t angle_to_pwm(float angle);
+		static uint16_t angle_to_pwm(float angle);
+};
+
+class I2c_Watchdog;
+
+// The car's two boards (motors and steering servo) behind the historical
+// static API
+class I2c_PcA9685
+{
+	private:
+		static std::unique_ptr<I2c_PcA9685_Device> _mot;
+		static std::unique_ptr<I2c_PcA9685_Device> _servo;
+		static std::atomic<I2c_Watchdog *> _watchdog;
 
 	public:
-		static void init(uint8_t addr_mot, uint8_t addr_servo,std::string i2c_device);
+		static void init(uint8_t addr_mot, uint8_t addr_servo,std::string i2c_device,
+				 bool warm_start = false);
+		static void init(std::unique_ptr<I2c_Transport> mot, std::unique_ptr<I2c_Transport> servo,
+				 bool warm_start = false);
+		static void init_boards(I2c_PcA9685_Device &mot, I2c_PcA9685_Device &servo, bool warm_start);
 		static void end_motor_use();
 		static void stop_all();
 		static void stop_motors();
+		// Every channel of both boards full off, one transaction per board
+		static void emergency_stop();
 		static void motor(int mot,int speed,bool dir);
+		// Every motor() then counts as a heartbeat; nullptr detaches it
+		static void watch(I2c_Watchdog *watchdog);
+		// Kicks the attached watchdog, if any (I2c_Trajectory drives the
+		// motors without going through motor())
+		static void heartbeat();
    		static void set_servo_angle( float angle);
+		// Non-throwing versions, see I2c_PcA9685_Device::try_motor()
+		static I2c_Status try_motor(int mot, int speed, bool dir) noexcept;
+		static I2c_Status try_set_servo_angle(float angle) noexcept;
+		static I2c_Status try_stop_all() noexcept;
+		static I2c_Status try_emergency_stop() noexcept;
+		// Blocks as it always did: brakes with the default profile and
+		// returns once the motors coast again
 		static void brake_motor();
+		// Non-blocking, released by brake_update()
+		static void brake_motor(const I2c_BrakeProfile &profile);
+		static uint64_t brake_update();
+		static void invalidate_cache();
+		static I2c_PcA9685_Device &motor_board();
+		static I2c_PcA9685_Device &servo_board();
 
 };
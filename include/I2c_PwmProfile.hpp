@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#define I2C_PCA9685_OSC_HZ	25000000u	// internal oscillator
+#define I2C_PCA9685_TICKS	4096u		// counter steps per PWM period
+
+// PWM timing of a PCA9685 running with a given PRE_SCALE value
+template <unsigned Prescaler>
+struct I2c_PwmProfile
+{
+	static_assert(Prescaler >= 3 && Prescaler <= 255, "PCA9685 PRE_SCALE must be 3..255");
+
+	static constexpr unsigned prescaler = Prescaler;
+	// One counter tick lasts (Prescaler + 1) / 25 MHz
+	static constexpr uint32_t period_us = (uint64_t)I2C_PCA9685_TICKS * (Prescaler + 1) * 1000000 / I2C_PCA9685_OSC_HZ;
+
+	// Nearest tick count for a pulse of us microseconds
+	static constexpr uint16_t us_to_ticks(uint32_t us)
+	{
+		return (uint16_t)(((uint64_t)us * (I2C_PCA9685_OSC_HZ / 1000000) * 2 + (Prescaler + 1)) / (2 * (Prescaler + 1)));
+	}
+};
+
+constexpr std::array<uint16_t, 101> I2c_duty_table()
+{
+	std::array<uint16_t, 101> t = {};
+	for (size_t i = 0; i <= 100; ++i)
+		t[i] = (uint16_t)(i * (I2C_PCA9685_TICKS - 1) / 100);
+	return t;
+}
+
+// Percent (0..100) to OFF tick count, integer only
+struct I2c_DutyTable
+{
+	static constexpr std::array<uint16_t, 101> table = I2c_duty_table();
+
+	static uint16_t percent(int p)
+	{
+		p = p < 0 ? -p : p;
+		return table[p < 100 ? p : 100];
+	}
+};
+
+// A servo model: pulse width at both ends of its travel, on a board set up
+// with Prescaler. The angle -> ticks table is built at compile time with
+// StepsPerDegree entries per degree, so a lookup is a clamp and an index.
+template <unsigned MinUs, unsigned MaxUs, unsigned Degrees = 180, unsigned Prescaler = 121,
+	  unsigned StepsPerDegree = 4>
+struct I2c_ServoProfile
+{
+	typedef I2c_PwmProfile<Prescaler> Pwm;
+	static constexpr size_t STEPS = (size_t)Degrees * StepsPerDegree;
+
+	static_assert(MinUs < MaxUs, "servo min pulse must be below max pulse");
+	static_assert(MaxUs < Pwm::period_us, "servo max pulse does not fit in the PWM period");
+	static_assert(Degrees > 0 && Degrees <= 360, "servo travel must be 1..360 degrees");
+	static_assert(StepsPerDegree > 0, "servo table needs at least one step per degree");
+	static_assert(Pwm::us_to_ticks(MaxUs) - Pwm::us_to_ticks(MinUs) >= Degrees,
+		      "servo range resolves less than one tick per degree at this prescaler");
+
+	static constexpr std::array<uint16_t, STEPS + 1> make()
+	{
+		std::array<uint16_t, STEPS + 1> t = {};
+		for (size_t i = 0; i <= STEPS; ++i)
+			t[i] = Pwm::us_to_ticks(MinUs + (uint32_t)(((uint64_t)(MaxUs - MinUs) * i + STEPS / 2) / STEPS));
+		return t;
+	}
+	static constexpr std::array<uint16_t, STEPS + 1> table = make();
+
+	static constexpr bool monotonic()
+	{
+		for (size_t i = 1; i <= STEPS; ++i)
+			if (table[i] < table[i - 1])
+				return false;
+		return true;
+	}
+	static_assert(monotonic(), "servo table is not monotonic");
+
+	static constexpr uint16_t min_ticks = table[0];
+	static constexpr uint16_t max_ticks = table[STEPS];
+
+	// Out-of-range angles (and NaN) are clamped to the ends of the travel
+	static uint16_t ticks(float angle)
+	{
+		float steps = std::fmin(std::fmax(angle * StepsPerDegree, 0.0f), (float)STEPS);
+		return table[(size_t)(steps + 0.5f)];
+	}
+};
+
+// 0.5-2.5 ms hobby servo over 180 degrees at ~50 Hz (PRE_SCALE 121), the
+// steering servo of the car
+typedef I2c_ServoProfile<500, 2500> I2c_ServoDefault;
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free queue, many producers and a single consumer.
+// Each cell carries a sequence number telling whether it is free for the
+// producer of a given ticket or holds an item for the consumer (Vyukov).
+template <typename T, size_t N>
+class I2c_MpscQueue
+{
+	static_assert(N > 1 && (N & (N - 1)) == 0, "I2c_MpscQueue capacity must be a power of two");
+
+	private:
+		struct Cell
+		{
+			std::atomic<size_t> seq;
+			T item;
+		};
+
+		alignas(64) Cell _cells[N];
+		alignas(64) std::atomic<size_t> _tail;  // next ticket for producers
+		alignas(64) size_t _head;               // consumer only
+
+	public:
+		I2c_MpscQueue() : _tail(0), _head(0)
+		{
+			for (size_t i = 0; i < N; ++i)
+				_cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+
+		// False when the queue is full
+		bool push(const T &item)
+		{
+			size_t pos = _tail.load(std::memory_order_relaxed);
+
+			for (;;) {
+				Cell &cell = _cells[pos & (N - 1)];
+				size_t seq = cell.seq.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+				if (diff == 0) {
+					if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = _tail.load(std::memory_order_relaxed);
+				}
+			}
+			Cell &cell = _cells[pos & (N - 1)];
+			cell.item = item;
+			cell.seq.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer thread only. False when the queue is empty
+		bool pop(T &item)
+		{
+			Cell &cell = _cells[_head & (N - 1)];
+
+			if (cell.seq.load(std::memory_order_acquire) != _head + 1)
+				return false;
+			item = cell.item;
+			cell.seq.store(_head + N, std::memory_order_release);
+			_head++;
+			return true;
+		}
+
+		// Consumer thread only
+		bool empty() const
+		{
+			return _cells[_head & (N - 1)].seq.load(std::memory_order_acquire) != _head + 1;
+		}
+};
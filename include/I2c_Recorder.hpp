@@ -0,0 +1,112 @@
+#pragma once
+
+#include <linux/i2c.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define I2C_RECORDER_MAGIC "I2CREC1"
+#define I2C_RECORDER_DATA 36   // payload bytes per record
+
+enum class I2c_RecordType : uint8_t
+{
+	Write = 1,     // reg + data written (long writes span several records)
+	Read,          // reg written, data read back, one transaction
+	Command,       // driver call, see I2c_RecordCommand
+	Sample,        // converted INA219 sample, see I2c_RecordSample
+};
+
+// reg field of a Command record; args in data as int32 (angle as float bits)
+enum class I2c_RecordCommand : uint8_t
+{
+	Motor = 1,          // mot, speed, dir
+	Servo,              // channel, angle
+	StopMotors,
+	StopAll,
+	EmergencyStop,
+	Brake,              // mode, duration_us, intensity, pulse_us
+};
+
+struct I2c_RecordSample
+{
+	int32_t bus_uv;
+	int32_t shunt_uv;
+	int32_t current_ua;
+	uint32_t power_uw;
+	uint16_t raw[4];   // shunt, bus, current, power registers
+};
+
+// One 64-byte slot of the ring. seq is stored last: a slot whose seq is
+// not its index + 1 is empty, overwritten or torn by a crash.
+struct I2c_RecordEntry
+{
+	uint64_t seq;
+	uint64_t timestamp_ns;   // CLOCK_MONOTONIC, start of the transaction
+	uint8_t type;            // I2c_RecordType
+	uint8_t device;          // as given to I2c_Transport::set_recorder()
+	uint8_t reg;
+	uint8_t len;             // bytes of data used
+	uint8_t op;              // I2c_Op of a transaction
+	uint8_t flags;
+	int16_t status;          // 0 or -errno
+	uint32_t duration_ns;
+	uint8_t data[I2C_RECORDER_DATA];
+};
+
+static_assert(sizeof(I2c_RecordEntry) == 64, "I2c_RecordEntry must stay 64 bytes");
+
+// First page of the file. magic is written last when the file is created;
+// head counts records ever claimed; clean is set by a normal close.
+struct I2c_RecorderHeader
+{
+	char magic[8];
+	uint32_t record_size;
+	uint32_t clean;
+	uint64_t capacity;
+	uint64_t created_realtime_ns;   // with created_monotonic_ns, maps
+	uint64_t created_monotonic_ns;  // record timestamps to wall time
+	std::atomic<uint64_t> head;
+};
+
+// Flight recorder: a preallocated, mmap'd file used as a ring of fixed-size
+// records. Appending is an atomic increment and stores into the mapping
+// (pages are populated up front): no syscall, no lock, any thread. The
+// kernel writes the pages back, so what was recorded survives a crash of
+// the process; sync() also covers a power loss up to that point.
+class I2c_Recorder
+{
+	private:
+		int _fd;
+		size_t _size;
+		I2c_RecorderHeader *_header;
+		I2c_RecordEntry *_ring;
+		uint64_t _mask;
+
+		I2c_RecordEntry &claim(uint64_t &seq);
+
+	public:
+		// capacity: records, a power of two; the file is created or replaced
+		I2c_Recorder(const std::string &path, uint64_t capacity);
+		~I2c_Recorder();
+		I2c_Recorder(const I2c_Recorder &) = delete;
+		I2c_Recorder &operator=(const I2c_Recorder &) = delete;
+
+		// One transaction as seen by I2c_Transport
+		void transaction(uint8_t device, const struct i2c_msg *msgs, size_t count, int op, int status,
+				 uint64_t start_ns, uint64_t duration_ns);
+		void command(uint8_t device, I2c_RecordCommand cmd, int32_t a0 = 0, int32_t a1 = 0,
+			     int32_t a2 = 0, int32_t a3 = 0);
+		void sample(uint8_t device, uint64_t timestamp_ns, const I2c_RecordSample &s);
+
+		uint64_t recorded() const { return _header->head.load(std::memory_order_relaxed); }
+		uint64_t capacity() const { return _mask + 1; }
+		// Blocks until the pages are on disk
+		void sync();
+
+		// Records still in the file, oldest first, torn ones skipped.
+		// Returns false if path is not a recorder file.
+		static bool load(const std::string &path, std::vector<I2c_RecordEntry> &out,
+				 I2c_RecorderHeader *header = nullptr);
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+
+// Why a non-throwing call failed
+enum class I2c_Error : uint8_t
+{
+	None = 0,
+	Again,      // EAGAIN: adapter busy / arbitration lost
+	Nack,       // EREMOTEIO, ENXIO: no acknowledge from the device
+	Timeout,    // ETIMEDOUT
+	Io,         // EIO or a short transfer
+	Range,      // EINVAL: channel or length out of range
+	NoDevice,   // ENODEV, EBADF: the bus is gone
+	Other,
+};
+
+inline I2c_Error I2c_error_from_errno(int err) noexcept
+{
+	switch (err < 0 ? -err : err) {
+	case 0:         return I2c_Error::None;
+	case EAGAIN:    return I2c_Error::Again;
+	case EREMOTEIO:
+	case ENXIO:     return I2c_Error::Nack;
+	case ETIMEDOUT: return I2c_Error::Timeout;
+	case EIO:       return I2c_Error::Io;
+	case EINVAL:    return I2c_Error::Range;
+	case ENODEV:
+	case EBADF:     return I2c_Error::NoDevice;
+	default:        return I2c_Error::Other;
+	}
+}
+
+inline const char *I2c_error_name(I2c_Error e) noexcept
+{
+	static const char *names[] = {"none", "again", "nack", "timeout", "io", "range", "no device", "other"};
+	return (size_t)e < sizeof(names) / sizeof(names[0]) ? names[(size_t)e] : "?";
+}
+
+// A value or the reason there is none, without exceptions. T must be
+// default constructible.
+template <typename T>
+class I2c_Result
+{
+	private:
+		T _value;
+		I2c_Error _error;
+
+	public:
+		I2c_Result(const T &value) noexcept : _value(value), _error(I2c_Error::None) {}
+		I2c_Result(I2c_Error error) noexcept : _value(), _error(error) {}
+
+		bool ok() const noexcept { return _error == I2c_Error::None; }
+		explicit operator bool() const noexcept { return ok(); }
+		I2c_Error error() const noexcept { return _error; }
+		// Meaningless unless ok()
+		const T &value() const noexcept { return _value; }
+		const T &operator*() const noexcept { return _value; }
+		const T *operator->() const noexcept { return &_value; }
+		T value_or(const T &fallback) const noexcept { return ok() ? _value : fallback; }
+};
+
+template <>
+class I2c_Result<void>
+{
+	private:
+		I2c_Error _error;
+
+	public:
+		I2c_Result() noexcept : _error(I2c_Error::None) {}
+		I2c_Result(I2c_Error error) noexcept : _error(error) {}
+		// From a transport return value: 0 or -errno
+		static I2c_Result from_errno(int ret) noexcept { return I2c_Result(I2c_error_from_errno(ret)); }
+
+		bool ok() const noexcept { return _error == I2c_Error::None; }
+		explicit operator bool() const noexcept { return ok(); }
+		I2c_Error error() const noexcept { return _error; }
+};
+
+typedef I2c_Result<void> I2c_Status;
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "I2c_Telemetry.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+struct I2c_RtConfig
+{
+	uint64_t period_ns = 10000000;  // 100 Hz
+	int priority = 0;               // SCHED_FIFO priority, 0 = normal scheduling
+	int cpu = -1;                   // CPU to pin the loop to, -1 = any
+	bool lock_memory = false;       // mlockall() so page faults cannot stall a period
+};
+
+// What a callback knows about the period it runs in (CLOCK_MONOTONIC ns)
+struct I2c_RtTick
+{
+	uint64_t index;     // period number since start
+	uint64_t release;   // when the period was scheduled to start
+	uint64_t wake;      // when the loop actually woke up
+	uint64_t deadline;  // start of the next period
+};
+
+// Fixed-period loop on its own thread, paced by an absolute timerfd.
+// Each period runs the callbacks in the order they were added, e.g. reading
+// an INA219 snapshot and commanding the boards, and records how late the loop
+// woke up and how long the callbacks took.
+class I2c_RtLoop
+{
+	public:
+		typedef std::function<void(const I2c_RtTick &)> Callback;
+
+	private:
+		I2c_RtConfig _config;
+		std::vector<Callback> _callbacks;
+		std::thread _thread;
+		std::atomic<bool> _run;
+		int _timer_fd;
+		I2c_Histogram _latency;
+		I2c_Histogram _runtime;
+		std::atomic<uint64_t> _periods;
+		std::atomic<uint64_t> _overruns;
+		std::atomic<uint64_t> _misses;
+		std::atomic<uint64_t> _errors;
+
+		void loop(uint64_t start);
+
+	public:
+		explicit I2c_RtLoop(const I2c_RtConfig &config = I2c_RtConfig());
+		~I2c_RtLoop();
+		I2c_RtLoop(const I2c_RtLoop &) = delete;
+		I2c_RtLoop &operator=(const I2c_RtLoop &) = delete;
+
+		// Only while stopped
+		void add(Callback callback);
+
+		// Throws if a requested real-time setting cannot be applied
+		// (SCHED_FIFO and mlockall usually need root or CAP_SYS_NICE/IPC_LOCK)
+		void start();
+		void stop();
+		bool running() const { return _thread.joinable(); }
+
+		// Wake-up delay after each period start, and callback run time, in ns
+		const I2c_Histogram &latency() const { return _latency; }
+		const I2c_Histogram &runtime() const { return _runtime; }
+		void reset_stats();
+
+		uint64_t periods() const { return _periods.load(std::memory_order_relaxed); }
+		// Periods skipped because the previous one ran too long
+		uint64_t overruns() const { return _overruns.load(std::memory_order_relaxed); }
+		// Periods whose callbacks finished after the deadline
+		uint64_t misses() const { return _misses.load(std::memory_order_relaxed); }
+		// Exceptions thrown by callbacks
+		uint64_t errors() const { return _errors.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "I2c_Transport.hpp"
+#include "I2c_Telemetry.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Priority classes of bus traffic, most urgent first
+enum class I2c_BusClass : uint8_t
+{
+	Safety = 0,   // emergency stops
+	Actuation,    // motor and servo updates
+	Telemetry,    // INA219 reads
+	Count
+};
+
+// Default wait budgets: a transaction granted later counts as late
+#define I2C_SCHED_SAFETY_US	100
+#define I2C_SCHED_ACTUATION_US	2000
+#define I2C_SCHED_TELEMETRY_US	20000
+
+// Arbiter for devices sharing one physical bus (e.g. both PCA9685 boards
+// and the INA219 on /dev/i2c-1). Each device's transport is wrapped by
+// transport(); the wrapper asks for the bus before every transaction.
+// When the bus is released it goes to the waiting request of the highest
+// class, and among those to the earliest deadline (arrival + budget).
+// A request never waits behind a lower class, only behind the transaction
+// already on the wire: telemetry is therefore split into one transaction
+// per register, so an actuation update waits for at most one of those.
+// Whatever the transport's class, a transaction tagged
+// I2C_OP_EMERGENCY_STOP (the PCA9685 ALL_LED full-off write) runs as Safety.
+class I2c_BusScheduler
+{
+	private:
+		struct Waiter
+		{
+			uint8_t cls;
+			uint64_t deadline;
+			uint64_t seq;
+			bool granted;
+			std::condition_variable cv;
+		};
+
+		std::mutex _lock;
+		std::vector<Waiter *> _waiting;
+		bool _busy;
+		uint64_t _seq;
+		std::atomic<uint64_t> _grants[(size_t)I2c_BusClass::Count];
+		std::atomic<uint64_t> _late[(size_t)I2c_BusClass::Count];
+		std::atomic<uint64_t> _splits;
+		I2c_Histogram _wait[(size_t)I2c_BusClass::Count];
+
+		void acquire(I2c_BusClass cls, uint64_t deadline);
+		void release();
+
+	public:
+		I2c_BusScheduler();
+		I2c_BusScheduler(const I2c_BusScheduler &) = delete;
+		I2c_BusScheduler &operator=(const I2c_BusScheduler &) = delete;
+
+		// device: the transport of one chip on the shared bus. budget_us < 0
+		// takes the class default. The scheduler must outlive the result.
+		std::unique_ptr<I2c_Transport> transport(std::unique_ptr<I2c_Transport> device, I2c_BusClass cls,
+							 int32_t budget_us = -1);
+
+		// One transaction on device once the bus is granted
+		int run(I2c_Transport &device, struct i2c_msg *msgs, size_t count, I2c_BusClass cls, uint64_t deadline);
+		void count_split() { _splits.fetch_add(1, std::memory_order_relaxed); }
+
+		uint64_t grants(I2c_BusClass cls) const { return _grants[(size_t)cls].load(std::memory_order_relaxed); }
+		// Granted after their deadline
+		uint64_t late(I2c_BusClass cls) const { return _late[(size_t)cls].load(std::memory_order_relaxed); }
+		// Telemetry transactions sent as several
+		uint64_t splits() const { return _splits.load(std::memory_order_relaxed); }
+		// From the request to the grant, in ns
+		const I2c_Histogram &wait(I2c_BusClass cls) const { return _wait[(size_t)cls]; }
+};
+
+// A device transport whose transactions go through an I2c_BusScheduler
+class I2c_ScheduledTransport : public I2c_Transport
+{
+	private:
+		I2c_BusScheduler &_scheduler;
+		std::unique_ptr<I2c_Transport> _device;
+		I2c_BusClass _class;
+		uint64_t _budget_ns;
+		bool _split;
+
+	public:
+		I2c_ScheduledTransport(I2c_BusScheduler &scheduler, std::unique_ptr<I2c_Transport> device,
+				       I2c_BusClass cls, uint64_t budget_ns);
+
+		int transfer(struct i2c_msg *msgs, size_t count) override;
+
+		I2c_BusClass bus_class() const { return _class; }
+		// On by default for telemetry: each register read (pointer write +
+		// read) becomes its own transaction. The registers of one call may
+		// then come from different conversions.
+		void set_split(bool on) { _split = on; }
+		I2c_Transport &device() { return *_device; }
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Sequence lock. Readers never take a lock: they retry if a write happened
+// while they were copying. Concurrent writers take turns on the odd sequence.
+// The payload is stored as relaxed atomic words so a torn read is detected
+// by the sequence check instead of being a data race.
+template <typename T>
+class I2c_Seqlock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "I2c_Seqlock needs a trivially copyable type");
+
+	private:
+		static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+		std::atomic<uint32_t> _seq;
+		std::atomic<uint64_t> _data[WORDS];
+
+	public:
+		I2c_Seqlock() : _seq(0)
+		{
+			for (size_t i = 0; i < WORDS; ++i)
+				_data[i].store(0, std::memory_order_relaxed);
+		}
+
+		void store(const T &value)
+		{
+			uint64_t words[WORDS] = {};
+			uint32_t seq = _seq.load(std::memory_order_relaxed);
+
+			memcpy(words, &value, sizeof(T));
+			do {
+				while (seq & 1)
+					seq = _seq.load(std::memory_order_relaxed);
+			} while (!_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire,
+							     std::memory_order_relaxed));
+			std::atomic_thread_fence(std::memory_order_release);
+			for (size_t i = 0; i < WORDS; ++i)
+				_data[i].store(words[i], std::memory_order_relaxed);
+			_seq.store(seq + 2, std::memory_order_release);
+		}
+
+		T load() const
+		{
+			uint64_t words[WORDS];
+			uint32_t before;
+			uint32_t after;
+			T value;
+
+			do {
+				before = _seq.load(std::memory_order_acquire);
+				for (size_t i = 0; i < WORDS; ++i)
+					words[i] = _data[i].load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				after = _seq.load(std::memory_order_relaxed);
+			} while ((before & 1) || before != after);
+			memcpy(&value, words, sizeof(T));
+			return value;
+		}
+
+		// Number of completed writes
+		uint32_t version() const { return _seq.load(std::memory_order_acquire) / 2; }
+};
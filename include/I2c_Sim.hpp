@@ -0,0 +1,129 @@
+#pragma once
+
+#include "I2c_Transport.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// In-process models of the chips on the car, so the drivers can run and be
+// measured on hosts without I2C hardware.
+
+// A device on the simulated bus. write() receives the bytes of one write
+// message, read() fills the bytes of one read message.
+class I2c_SimDevice
+{
+	public:
+		virtual ~I2c_SimDevice() {}
+		virtual void write(const uint8_t *data, size_t len) = 0;
+		virtual void read(uint8_t *data, size_t len) = 0;
+};
+
+// PCA9685: 256-byte register file with the MODE1 AI pointer increment,
+// sleep-gated PRE_SCALE and the ALL_LED broadcast registers
+class I2c_SimPcA9685 : public I2c_SimDevice
+{
+	private:
+		uint8_t _regs[256];
+		uint8_t _ptr;
+
+		void write_reg(uint8_t reg, uint8_t val);
+
+	public:
+		I2c_SimPcA9685();
+		void reset();
+		void write(const uint8_t *data, size_t len) override;
+		void read(uint8_t *data, size_t len) override;
+
+		uint8_t reg(uint8_t reg) const { return _regs[reg]; }
+		uint16_t on(uint8_t channel) const;
+		uint16_t off(uint8_t channel) const;
+		bool full_off(uint8_t channel) const;
+		float duty(uint8_t channel) const;    // fraction of the period high
+		float frequency() const;              // Hz from PRE_SCALE, 25 MHz osc
+		bool sleeping() const;
+};
+
+// INA219: shunt/bus ADC with PGA clipping, calibration based current and
+// power registers, and conversion timing driving the CNVR/OVF flags
+class I2c_SimINA219 : public I2c_SimDevice
+{
+	private:
+		uint16_t _regs[6];
+		uint8_t _ptr;
+		double _shunt_v;
+		double _bus_v;
+		uint64_t _next_conv_ns;
+
+		uint64_t conversion_ns() const;
+		void convert();
+		void update(uint64_t now_ns);
+
+	public:
+		I2c_SimINA219();
+		void reset();
+		void write(const uint8_t *data, size_t len) override;
+		void read(uint8_t *data, size_t len) override;
+
+		// Analog inputs seen by the next conversions
+		void set_inputs(double shunt_volts, double bus_volts);
+		// Finishes the conversion in progress right away
+		void complete_conversion();
+		uint16_t reg(uint8_t reg) const { return _regs[reg]; }
+};
+
+// Traffic counters of the simulated bus
+struct I2c_SimStats
+{
+	uint64_t transactions;  // transfer() calls, i.e. syscalls on i2c-dev
+	uint64_t messages;
+	uint64_t bytes;         // payload bytes, address bytes excluded
+	uint64_t bus_ns;        // modelled time on the wire
+	uint64_t errors;
+};
+
+// A simulated bus: routes transactions to the attached devices by address
+// and models the time they would take on the wire
+class I2c_SimBus
+{
+	private:
+		std::map<uint8_t, I2c_SimDevice *> _devices;
+		std::mutex _lock;
+		uint32_t _clock_hz;
+		bool _realtime;
+		bool _read_last;
+		unsigned _fail_count;
+		int _fail_errno;
+		I2c_SimStats _stats;
+
+	public:
+		explicit I2c_SimBus(uint32_t clock_hz = 100000);
+
+		// The device is not owned and must outlive the bus
+		void attach(uint8_t addr, I2c_SimDevice *dev);
+		void detach(uint8_t addr);
+		std::unique_ptr<I2c_Transport> transport(uint8_t addr);
+		int transfer(uint8_t addr, struct i2c_msg *msgs, size_t count);
+
+		// Busy-wait the modelled wire time inside every transaction
+		void set_realtime(bool on) { _realtime = on; }
+		// Like i2c-bcm2835: a read that is not the last message fails the
+		// transaction with -EOPNOTSUPP
+		void set_read_last_only(bool on) { _read_last = on; }
+		// The next count transactions fail with -err (NACK by default)
+		void inject_errors(unsigned count, int err = EREMOTEIO);
+		I2c_SimStats stats();
+		void reset_stats();
+};
+
+class I2c_SimTransport : public I2c_Transport
+{
+	private:
+		I2c_SimBus &_bus;
+		uint8_t _addr;
+
+	public:
+		I2c_SimTransport(I2c_SimBus &bus, uint8_t addr) : _bus(bus), _addr(addr) {}
+		int transfer(struct i2c_msg *msgs, size_t count) override;
+};
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Contiguous read-only view into a buffer owned by someone else
+template <typename T>
+struct I2c_Span
+{
+	const T *data;
+	size_t size;
+
+	const T *begin() const { return data; }
+	const T *end() const { return data + size; }
+	const T &operator[](size_t i) const { return data[i]; }
+};
+
+// Fixed-capacity ring of the last N items, no allocation after construction.
+// One producer pushes; consumers look at the stored items in place through
+// view() and use overwritten() afterwards to know if the producer lapped them.
+// The view holds at most N - 1 items: the slot the next push() writes into
+// is never part of it.
+template <typename T, size_t N>
+class I2c_RingBuffer
+{
+	static_assert(N > 0 && (N & (N - 1)) == 0, "I2c_RingBuffer capacity must be a power of two");
+
+	private:
+		T _items[N];
+		std::atomic<uint64_t> _head;  // items pushed so far
+
+	public:
+		I2c_RingBuffer() : _head(0) {}
+
+		static size_t capacity() { return N; }
+
+		void push(const T &item)
+		{
+			uint64_t head = _head.load(std::memory_order_relaxed);
+
+			_items[head & (N - 1)] = item;
+			_head.store(head + 1, std::memory_order_release);
+		}
+
+		size_t size() const
+		{
+			uint64_t head = _head.load(std::memory_order_acquire);
+			return head < N ? head : N - 1;
+		}
+
+		// Stored items, oldest first: older part in first, newer in second.
+		// Returns the sequence number of the oldest item in the view.
+		uint64_t view(I2c_Span<T> &first, I2c_Span<T> &second) const
+		{
+			uint64_t head = _head.load(std::memory_order_acquire);
+			uint64_t oldest = head < N ? 0 : head - N + 1;
+			size_t start = oldest & (N - 1);
+			size_t count = head - oldest;
+
+			if (start + count <= N) {
+				first = I2c_Span<T>{_items + start, count};
+				second = I2c_Span<T>{_items, 0};
+			} else {
+				first = I2c_Span<T>{_items + start, N - start};
+				second = I2c_Span<T>{_items, count - (N - start)};
+			}
+			return oldest;
+		}
+
+		// True if the item with sequence number seq is being or has been
+		// replaced since it was viewed; data read from the view after that
+		// point is unreliable. The fence keeps those reads before the check.
+		bool overwritten(uint64_t seq) const
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return _head.load(std::memory_order_relaxed) >= seq + N;
+		}
+};
+
+// Statistics of one signal
+struct I2c_Stats
+{
+	uint32_t count;    // values in the window
+	double min;
+	double max;
+	double mean;
+	double variance;   // sample variance of the window
+	double ewma;       // over every value, not just the window
+};
+
+// Sliding-window min/max/mean/variance plus an EWMA, O(1) per value
+// (amortized). The window is chosen at runtime, up to N values.
+template <size_t N>
+class I2c_WindowStats
+{
+	private:
+		double _vals[N];
+		uint64_t _minq[N];  // monotonic deques of value sequence numbers
+		uint64_t _maxq[N];
+		size_t _min_head, _min_len;
+		size_t _max_head, _max_len;
+		size_t _window;
+		uint64_t _seq;      // values pushed so far
+		double _shift;      // first value, keeps the sums well conditioned
+		double _sum;
+		double _sumsq;
+		double _alpha;
+		double _ewma;
+
+		double val(uint64_t seq) const { return _vals[seq % _window]; }
+
+		void recompute_sums()
+		{
+			size_t n = _seq < _window ? _seq : _window;
+
+			_sum = 0;
+			_sumsq = 0;
+			for (size_t i = 0; i < n; ++i) {
+				double d = _vals[i] - _shift;
+				_sum += d;
+				_sumsq += d * d;
+			}
+		}
+
+	public:
+		I2c_WindowStats() { configure(N, 0.1); }
+
+		// Clears the history
+		void configure(size_t window, double ewma_alpha)
+		{
+			_window = (window == 0 || window > N) ? N : window;
+			_alpha = ewma_alpha;
+			_min_head = _min_len = 0;
+			_max_head = _max_len = 0;
+			_seq = 0;
+			_shift = _sum = _sumsq = _ewma = 0;
+		}
+
+		void push(double x)
+		{
+			if (_seq == 0) {
+				_shift = x;
+				_ewma = x;
+			} else {
+				_ewma += _alpha * (x - _ewma);
+			}
+
+			// Drop the value leaving the window
+			if (_seq >= _window) {
+				uint64_t gone = _seq - _window;
+				double d = val(gone) - _shift;
+				_sum -= d;
+				_sumsq -= d * d;
+				if (_min_len && _minq[_min_head] == gone) {
+					_min_head = (_min_head + 1) % N;
+					_min_len--;
+				}
+				if (_max_len && _maxq[_max_head] == gone) {
+					_max_head = (_max_head + 1) % N;
+					_max_len--;
+				}
+			}
+
+			_vals[_seq % _window] = x;
+			double d = x - _shift;
+			_sum += d;
+			_sumsq += d * d;
+			while (_min_len && val(_minq[(_min_head + _min_len - 1) % N]) >= x)
+				_min_len--;
+			_minq[(_min_head + _min_len++) % N] = _seq;
+			while (_max_len && val(_maxq[(_max_head + _max_len - 1) % N]) <= x)
+				_max_len--;
+			_maxq[(_max_head + _max_len++) % N] = _seq;
+			_seq++;
+
+			// Clear the rounding error of the running sums once per window
+			if (_seq % _window == 0)
+				recompute_sums();
+		}
+
+		I2c_Stats stats() const
+		{
+			I2c_Stats st = {};
+			size_t n = _seq < _window ? _seq : _window;
+
+			st.count = n;
+			if (n == 0)
+				return st;
+			st.min = val(_minq[_min_head]);
+			st.max = val(_maxq[_max_head]);
+			st.mean = _shift + _sum / n;
+			st.variance = n > 1 ? (_sumsq - _sum * _sum / n) / (n - 1) : 0;
+			if (st.variance < 0)
+				st.variance = 0;
+			st.ewma = _ewma;
+			return st;
+		}
+};
+
+#define I2C_HISTOGRAM_SUB	16	// buckets per power of two
+#define I2C_HISTOGRAM_BUCKETS	(61 * I2C_HISTOGRAM_SUB)
+
+// Copy of an I2c_Histogram at one point in time
+struct I2c_HistogramSnapshot
+{
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[I2C_HISTOGRAM_BUCKETS];
+
+	double mean() const { return count ? (double)sum / count : 0; }
+
+	// Upper bound of the bucket holding the q-quantile (0..1)
+	uint64_t percentile(double q) const
+	{
+		uint64_t rank = (uint64_t)std::ceil(q * count);
+		uint64_t seen = 0;
+
+		if (count == 0)
+			return 0;
+		if (rank == 0)
+			rank = 1;
+		for (size_t i = 0; i < I2C_HISTOGRAM_BUCKETS; ++i) {
+			seen += buckets[i];
+			if (seen >= rank) {
+				uint64_t hi = i + 1 < I2C_HISTOGRAM_BUCKETS ? bucket_low(i + 1) - 1 : UINT64_MAX;
+				return hi < max ? hi : max;
+			}
+		}
+		return max;
+	}
+
+	static uint64_t bucket_low(size_t i)
+	{
+		if (i < I2C_HISTOGRAM_SUB)
+			return i;
+		size_t group = i / I2C_HISTOGRAM_SUB - 1;
+		return (uint64_t)(I2C_HISTOGRAM_SUB + i % I2C_HISTOGRAM_SUB) << group;
+	}
+};
+
+// Log-linear histogram of durations (or any unsigned value): 16 buckets per
+// power of two, so a value is placed within 1/16 of itself. Recording is a few
+// relaxed atomic adds and may happen from any thread.
+class I2c_Histogram
+{
+	private:
+		std::atomic<uint64_t> _count;
+		std::atomic<uint64_t> _sum;
+		std::atomic<uint64_t> _min;
+		std::atomic<uint64_t> _max;
+		std::atomic<uint64_t> _buckets[I2C_HISTOGRAM_BUCKETS];
+
+	public:
+		I2c_Histogram() { reset(); }
+
+		static size_t bucket(uint64_t v)
+		{
+			if (v < I2C_HISTOGRAM_SUB)
+				return v;
+			int msb = 63 - __builtin_clzll(v);
+			int shift = msb - 4;
+			return (shift + 1) * I2C_HISTOGRAM_SUB + ((v >> shift) & (I2C_HISTOGRAM_SUB - 1));
+		}
+
+		void record(uint64_t v)
+		{
+			uint64_t cur;
+
+			_buckets[bucket(v)].fetch_add(1, std::memory_order_relaxed);
+			_count.fetch_add(1, std::memory_order_relaxed);
+			_sum.fetch_add(v, std::memory_order_relaxed);
+			cur = _min.load(std::memory_order_relaxed);
+			while (v < cur && !_min.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+				;
+			cur = _max.load(std::memory_order_relaxed);
+			while (v > cur && !_max.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+				;
+		}
+
+		// Not atomic as a whole: a record() running meanwhile may be half in
+		void snapshot(I2c_HistogramSnapshot &out) const
+		{
+			out.count = 0;
+			for (size_t i = 0; i < I2C_HISTOGRAM_BUCKETS; ++i) {
+				out.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+				out.count += out.buckets[i];
+			}
+			out.sum = _sum.load(std::memory_order_relaxed);
+			out.min = out.count ? _min.load(std::memory_order_relaxed) : 0;
+			out.max = _max.load(std::memory_order_relaxed);
+		}
+
+		void reset()
+		{
+			for (size_t i = 0; i < I2C_HISTOGRAM_BUCKETS; ++i)
+				_buckets[i].store(0, std::memory_order_relaxed);
+			_count.store(0, std::memory_order_relaxed);
+			_sum.store(0, std::memory_order_relaxed);
+			_min.store(UINT64_MAX, std::memory_order_relaxed);
+			_max.store(0, std::memory_order_relaxed);
+		}
+
+		uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "I2c_PcA9685.hpp"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Moves a value toward a target with a limited rate and, optionally, a
+// limited change of that rate (0 = rate limit only, no rate limit = jump)
+class I2c_Ramp
+{
+	private:
+		float _value;
+		float _rate;
+		float _max_rate;
+		float _max_accel;
+
+	public:
+		I2c_Ramp() : _value(0), _rate(0), _max_rate(0), _max_accel(0) {}
+
+		void configure(float max_rate, float max_accel) { _max_rate = max_rate; _max_accel = max_accel; }
+		void reset(float value) { _value = value; _rate = 0; }
+		float step(float target, float dt);
+		float value() const { return _value; }
+		bool settled(float target) const { return _value == target && _rate == 0; }
+};
+
+// Ramps the motors and slews the steering servo at a fixed rate on its own
+// thread. Callers only set targets, which never blocks or touches the bus;
+// each tick writes the channels whose value changed. While it runs it must
+// be the only one commanding the motors and servo channel 0 of these boards.
+// The thread sleeps once every output has reached its target.
+class I2c_Trajectory
+{
+	private:
+		I2c_PcA9685_Device &_mot;
+		I2c_PcA9685_Device &_servo;
+		uint64_t _period_ns;
+		int _timer_fd;
+		int _wake_fd;
+		std::thread _thread;
+		std::atomic<bool> _run;
+		std::atomic<bool> _sleeping;
+		std::atomic<bool> _stop;
+		std::atomic<float> _target[3];  // motor 1, motor 2 (signed %), servo (deg)
+		std::atomic<float> _limit[4];   // motor accel, motor jerk, servo rate, servo accel
+		std::atomic<uint64_t> _ticks;
+		std::atomic<uint64_t> _updates;
+		std::atomic<uint64_t> _overruns;
+		std::atomic<uint64_t> _errors;
+
+		// Trajectory thread only
+		I2c_Ramp _ramp[3];
+		int _out_speed[2];
+		uint16_t _out_servo;
+
+		void loop();
+		bool tick(float dt);
+		bool settled();
+		void arm(bool on);
+		void wake();
+
+	public:
+		I2c_Trajectory(I2c_PcA9685_Device &mot, I2c_PcA9685_Device &servo, unsigned rate_hz = 100);
+		~I2c_Trajectory();
+		I2c_Trajectory(const I2c_Trajectory &) = delete;
+		I2c_Trajectory &operator=(const I2c_Trajectory &) = delete;
+
+		// %/s and %/s^2; 0 jerk = acceleration limit only
+		void motor_limits(float accel, float jerk);
+		// deg/s and deg/s^2
+		void servo_limits(float rate, float accel);
+
+		// Targets, same arguments as I2c_PcA9685::motor()/set_servo_angle().
+		// The first servo target is applied directly, its position being unknown.
+		// motor() and every tick that writes the motors kick the watchdog
+		// attached with I2c_PcA9685::watch().
+		void motor(int mot, int speed, bool dir);
+		void set_servo_angle(float angle);
+		// Skips the ramp: the motors stop on the next tick
+		void stop_motors();
+
+		uint64_t ticks() const { return _ticks.load(std::memory_order_relaxed); }
+		uint64_t updates() const { return _updates.load(std::memory_order_relaxed); }
+		uint64_t overruns() const { return _overruns.load(std::memory_order_relaxed); }
+		uint64_t errors() const { return _errors.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <linux/i2c.h>
+#include "I2c_Metrics.hpp"
+
+class I2c_Recorder;
+
+// Transient failures retried inside the transport: EAGAIN (adapter busy,
+// arbitration lost) and EREMOTEIO (NACK). Other errors are returned at once.
+struct I2c_RetryPolicy
+{
+	uint8_t retries = 2;       // extra attempts after the first one
+	uint32_t backoff_us = 0;   // pause before each retry, doubled every time
+};
+
+// Byte-level access to one device on an I2C bus.
+// Every call returns 0 on success or -errno on failure, never throws.
+class I2c_Transport
+{
+	protected:
+		I2c_Metrics _metrics;
+		I2c_RetryPolicy _retry;
+		I2c_Recorder *_recorder = nullptr;
+		uint8_t _recorder_device = 0;
+		bool _split_reads = false;
+		I2c_Op _op = I2C_OP_OTHER;  // of the transaction transfer() is sending
+
+		int send(struct i2c_msg *msgs, size_t count);
+
+	public:
+		virtual ~I2c_Transport() {}
+
+		// Runs the messages as one transaction (repeated start between
+		// them). The addr field of each message is filled by the transport.
+		virtual int transfer(struct i2c_msg *msgs, size_t count) = 0;
+
+		// transfer() with retries, timed and counted under op (one count
+		// per call whatever the attempts; see I2c_Metrics::retries).
+		// Adapters such as i2c-bcm2835 only take a read as the last message:
+		// after their first -EOPNOTSUPP, a transaction with reads in the
+		// middle is sent as one pointer write + read at a time.
+		int transaction(struct i2c_msg *msgs, size_t count, I2c_Op op = I2C_OP_OTHER);
+		int write(const uint8_t *data, size_t len, I2c_Op op = I2C_OP_OTHER);
+		int write_read(const uint8_t *wdata, size_t wlen, uint8_t *rdata, size_t rlen,
+			       I2c_Op op = I2C_OP_OTHER);
+
+		void set_retry_policy(const I2c_RetryPolicy &policy) { _retry = policy; }
+		const I2c_RetryPolicy &retry_policy() const { return _retry; }
+		// True once the adapter refused a read that was not the last message
+		bool split_reads() const { return _split_reads; }
+
+		// Every transaction is also appended to recorder, tagged with device
+		// (usually the address); nullptr stops recording
+		void set_recorder(I2c_Recorder *recorder, uint8_t device)
+		{
+			_recorder = recorder;
+			_recorder_device = device;
+		}
+		I2c_Recorder *recorder() const { return _recorder; }
+		uint8_t recorder_device() const { return _recorder_device; }
+
+		I2c_Metrics &metrics() { return _metrics; }
+		const I2c_Metrics &metrics() const { return _metrics; }
+};
+
+// Real backend: a /dev/i2c-N file descriptor bound to one slave address
+class I2c_DevTransport : public I2c_Transport
+{
+	private:
+		int _fd;
+		uint8_t _addr;
+		bool _rdwr;  // adapter supports I2C_RDWR (repeated start)
+
+	public:
+		I2c_DevTransport(const std::string &i2c_device, uint8_t addr);
+		~I2c_DevTransport();
+		I2c_DevTransport(const I2c_DevTransport &) = delete;
+		I2c_DevTransport &operator=(const I2c_DevTransport &) = delete;
+
+		int transfer(struct i2c_msg *msgs, size_t count) override;
+		int fd() const { return _fd; }
+		uint8_t addr() const { return _addr; }
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "I2c_PcA9685.hpp"
+#include "I2c_Telemetry.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+// Deadman switch. The application kicks it with every motor command or a
+// heartbeat; if no kick comes for timeout_us, its own thread runs the stop
+// action once. Kicking again re-arms it. kick() is one clock read and one
+// atomic store: no lock and no syscall.
+class I2c_Watchdog
+{
+	public:
+		typedef std::function<void()> Action;
+
+	private:
+		Action _stop;
+		uint64_t _timeout_ns;
+		std::thread _thread;
+		std::atomic<bool> _run;
+		std::atomic<uint64_t> _last_kick;  // CLOCK_MONOTONIC ns
+		std::atomic<bool> _tripped;
+		std::atomic<uint64_t> _trips;
+		std::atomic<uint64_t> _errors;
+		I2c_Histogram _reaction;
+
+		void loop();
+
+	public:
+		// priority > 0 runs the thread under SCHED_FIFO; throws if that is not allowed
+		I2c_Watchdog(Action stop, uint32_t timeout_us, int priority = 0);
+		~I2c_Watchdog();
+		I2c_Watchdog(const I2c_Watchdog &) = delete;
+		I2c_Watchdog &operator=(const I2c_Watchdog &) = delete;
+
+		void kick() noexcept;
+
+		bool tripped() const { return _tripped.load(std::memory_order_acquire); }
+		uint64_t trips() const { return _trips.load(std::memory_order_relaxed); }
+		// Stop actions that threw
+		uint64_t errors() const { return _errors.load(std::memory_order_relaxed); }
+		// From the missed deadline to the end of the stop action, in ns
+		const I2c_Histogram &reaction() const { return _reaction; }
+
+		// Fastest stop of a motor board: full-off through ALL_LED_OFF_H on a
+		// transport of the watchdog's own (e.g. a second i2c-dev fd to the
+		// same address), so it never waits for, or races with, the thread
+		// that owns dev. dev drops its cache on its next update.
+		static Action stop_board(I2c_PcA9685_Device &dev, std::unique_ptr<I2c_Transport> bus);
+};
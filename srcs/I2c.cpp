@@ -2,11 +2,11 @@
 #include <cstdint>
 
 
-void I2c::All_init()
+void I2c::All_init(uint8_t addr_mot, uint8_t addr_servo, uint8_t addr_ina, std::string i2c_device)
 {
 
-	I2c::I2c_PcA9685::init(0x60,0x40,"/dev/i2c-1");
-	I2c::I2c_INA219::init(0x41, "/dev/i2c-1");
+	I2c::I2c_PcA9685::init(addr_mot, addr_servo, i2c_device);
+	I2c::I2c_INA219::init(addr_ina, i2c_device);
 	
 
 }
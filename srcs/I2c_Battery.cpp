@@ -0,0 +1,94 @@
+#include "../include/I2c_Battery.hpp"
+#include <cmath>
+#include <stdexcept>
+
+#define SOC_STEP	(1.0 / (I2C_BATTERY_OCV_POINTS - 1))
+
+I2c_BatteryEstimator::I2c_BatteryEstimator(const I2c_BatteryConfig &config)
+{
+	configure(config);
+}
+
+void I2c_BatteryEstimator::configure(const I2c_BatteryConfig &config)
+{
+	if (config.capacity_mah <= 0)
+		throw std::runtime_error("Battery capacity must be positive");
+	for (int i = 1; i < I2C_BATTERY_OCV_POINTS; ++i)
+		if (config.ocv[i] <= config.ocv[i - 1])
+			throw std::runtime_error("Battery OCV curve must be increasing");
+	_config = config;
+	_state = I2c_BatteryState();
+	_variance = 0;
+	_seeded = false;
+}
+
+void I2c_BatteryEstimator::reset(double soc, double soc_std)
+{
+	_state.soc = std::fmin(std::fmax(soc, 0.0), 1.0);
+	_state.soc_std = soc_std;
+	_variance = soc_std * soc_std;
+	_seeded = true;
+}
+
+// Piecewise linear curve; *slope is dV/dsoc of the segment
+double I2c_BatteryEstimator::ocv(double soc, double *slope) const
+{
+	int i = (int)(soc / SOC_STEP);
+
+	if (i < 0)
+		i = 0;
+	if (i > I2C_BATTERY_OCV_POINTS - 2)
+		i = I2C_BATTERY_OCV_POINTS - 2;
+	*slope = (_config.ocv[i + 1] - _config.ocv[i]) / SOC_STEP;
+	return _config.ocv[i] + (soc - i * SOC_STEP) * *slope;
+}
+
+double I2c_BatteryEstimator::soc_from_ocv(double voltage) const
+{
+	int i = 0;
+
+	if (voltage <= _config.ocv[0])
+		return 0;
+	if (voltage >= _config.ocv[I2C_BATTERY_OCV_POINTS - 1])
+		return 1;
+	while (voltage > _config.ocv[i + 1])
+		++i;
+	return (i + (voltage - _config.ocv[i]) / (_config.ocv[i + 1] - _config.ocv[i])) * SOC_STEP;
+}
+
+void I2c_BatteryEstimator::update(uint64_t timestamp_ns, double voltage, double current)
+{
+	double amps = current / 1000;
+	double z = voltage + amps * _config.resistance_ohm;
+	double predicted;
+	double slope;
+	double noise;
+	double gain;
+
+	if (!_seeded)
+		reset(soc_from_ocv(z), _config.initial_std);
+	else if (_state.timestamp_ns != 0 && timestamp_ns > _state.timestamp_ns) {
+		// Predict: trapezoidal coulomb count since the last sample
+		double dt = (timestamp_ns - _state.timestamp_ns) * 1e-9;
+		double mah = (current + _state.current) / 2 * dt / 3600;
+
+		_state.used_mah += mah;
+		_state.soc -= mah / _config.capacity_mah;
+		_variance += _config.drift_per_s * dt;
+	}
+
+	// Correct with the load-compensated voltage; trusted less under load
+	// and where the curve is flat
+	noise = _config.voltage_noise_v + _config.load_noise_v_per_a * std::fabs(amps);
+	predicted = ocv(_state.soc, &slope);
+	gain = _variance * slope / (slope * slope * _variance + noise * noise);
+	_state.soc += gain * (z - predicted);
+	_variance *= 1 - gain * slope;
+
+	_state.soc = std::fmin(std::fmax(_state.soc, 0.0), 1.0);
+	_state.soc_std = std::sqrt(_variance);
+	_state.ocv = z;
+	_state.current = current;
+	_state.timestamp_ns = timestamp_ns;
+	_state.samples++;
+}
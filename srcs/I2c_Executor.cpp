@@ -0,0 +1,244 @@
+#include "../include/I2c_Executor.hpp"
+#include "../include/I2c_Watchdog.hpp"
+#include "../include/I2c_Log.hpp"
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <utility>
+
+I2c_Executor::I2c_Executor(std::unique_ptr<I2c_Transport> mot, std::unique_ptr<I2c_Transport> servo)
+	: _mot(new I2c_PcA9685_Device(std::move(mot))), _servo(new I2c_PcA9685_Device(std::move(servo))),
+	  _run(true), _sleeping(false), _estop(false), _dropped(0), _errors(0), _watchdog(nullptr), _wake_fd(-1)
+{
+	if ((_wake_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+		throw std::runtime_error("Failed to create executor eventfd");
+	}
+	try {
+		I2c_PcA9685::init_boards(*_mot, *_servo, false);
+	} catch (...) {
+		close(_wake_fd);
+		throw;
+	}
+	_thread = std::thread(&I2c_Executor::loop, this);
+}
+
+I2c_Executor::I2c_Executor(uint8_t addr_mot, uint8_t addr_servo, const std::string &i2c_device)
+	: I2c_Executor(std::unique_ptr<I2c_Transport>(new I2c_DevTransport(i2c_device, addr_mot)),
+		       std::unique_ptr<I2c_Transport>(new I2c_DevTransport(i2c_device, addr_servo)))
+{
+}
+
+I2c_Executor::~I2c_Executor()
+{
+	uint64_t one = 1;
+
+	_run = false;
+	if (write(_wake_fd, &one, sizeof(one)) < 0) {
+		// The thread still sees _run on its next wake-up
+	}
+	_thread.join();
+	try {
+		_mot->stop_motors();
+	} catch (std::exception &e) {
+		// Nothing left to report to
+	}
+	close(_wake_fd);
+}
+
+// Only pays for the syscall when the executor went to sleep. The fence
+// pairs with the one in loop(): the push is visible to its empty() check,
+// or its _sleeping store is visible here (store-load on both sides).
+void I2c_Executor::wake()
+{
+	uint64_t one = 1;
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_sleeping.exchange(false)) {
+		if (write(_wake_fd, &one, sizeof(one)) < 0) {
+			_errors.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+void I2c_Executor::discard(const I2c_Command &cmd)
+{
+	if (cmd.done)
+		cmd.done->store(true, std::memory_order_release);
+	else
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Stops both boards, then drops whatever is still queued: those commands
+// would restart what the stop just ended
+void I2c_Executor::service_estop()
+{
+	I2c_Command cmd;
+
+	if (!_estop.exchange(false))
+		return;
+	if (!_mot->try_emergency_stop())
+		failed(-1);
+	if (!_servo->try_emergency_stop())
+		failed(-1);
+	while (_queue.pop(cmd))
+		discard(cmd);
+}
+
+// command: I2c_CommandType, -1 for the emergency stop
+void I2c_Executor::failed(int command)
+{
+	uint64_t errors = _errors.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	I2c_Log::log(I2c_LogLevel::Warn, I2c_LogEvent::ExecutorError, 2, command, errors);
+}
+
+bool I2c_Executor::submit(const I2c_Command &cmd)
+{
+	if (!_queue.push(cmd)) {
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	wake();
+	return true;
+}
+
+// Bus errors come back as a status; only the brake path still throws
+I2c_Status I2c_Executor::execute(const I2c_Command &cmd)
+{
+	I2c_Status status;
+	I2c_Status mot;
+
+	switch (cmd.type) {
+	case I2c_CommandType::Motor:
+		return _mot->try_motor(cmd.mot, cmd.speed, cmd.dir);
+	case I2c_CommandType::Servo:
+		return _servo->try_set_servo_angle(0, cmd.angle);
+	case I2c_CommandType::StopMotors:
+		return _mot->try_stop_motors();
+	case I2c_CommandType::StopAll:
+		status = _servo->try_stop_all();
+		mot = _mot->try_stop_all();
+		return mot ? status : mot;
+	case I2c_CommandType::Brake:
+		_mot->brake_motor(cmd.brake);
+		break;
+	case I2c_CommandType::Fence:
+		break;
+	}
+	return status;
+}
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void I2c_Executor::loop()
+{
+	struct pollfd pfd = {_wake_fd, POLLIN, 0};
+	I2c_Command cmd;
+	uint64_t count;
+	uint64_t deadline = 0;  // next brake step, 0 = none
+
+	while (_run.load(std::memory_order_relaxed)) {
+		service_estop();
+		while (_queue.pop(cmd)) {
+			if (_estop.load(std::memory_order_relaxed)) {
+				discard(cmd);
+				service_estop();
+				break;
+			}
+			try {
+				if (!execute(cmd))
+					failed((int)cmd.type);
+			} catch (std::exception &e) {
+				failed((int)cmd.type);
+			}
+			if (cmd.done)
+				cmd.done->store(true, std::memory_order_release);
+		}
+		try {
+			deadline = _mot->brake_update();
+		} catch (std::exception &e) {
+			failed((int)I2c_CommandType::Brake);
+			deadline = 0;
+		}
+		// Announce the sleep, then look again so a producer that missed
+		// the flag cannot leave a command behind
+		_sleeping.store(true);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!_queue.empty() || _estop.load() || !_run.load(std::memory_order_relaxed)) {
+			_sleeping.store(false);
+			continue;
+		}
+		if (deadline) {
+			uint64_t now = monotonic_ns();
+			uint64_t wait = deadline > now ? deadline - now : 0;
+			struct timespec ts = {(time_t)(wait / 1000000000ull), (long)(wait % 1000000000ull)};
+			if (ppoll(&pfd, 1, &ts, nullptr) > 0 && read(_wake_fd, &count, sizeof(count)) < 0) {
+				// Drained by an earlier read
+			}
+		} else if (read(_wake_fd, &count, sizeof(count)) < 0) {
+			// Interrupted, loop again
+		}
+		_sleeping.store(false);
+	}
+}
+
+bool I2c_Executor::motor(int mot, int speed, bool dir)
+{
+	I2c_Command cmd = {I2c_CommandType::Motor, mot, speed, dir, 0.0f, I2c_BrakeProfile(), nullptr};
+	I2c_Watchdog *watchdog = _watchdog.load(std::memory_order_acquire);
+
+	if (!submit(cmd))
+		return false;
+	if (watchdog)
+		watchdog->kick();
+	return true;
+}
+
+bool I2c_Executor::set_servo_angle(float angle)
+{
+	I2c_Command cmd = {I2c_CommandType::Servo, 0, 0, false, angle, I2c_BrakeProfile(), nullptr};
+	return submit(cmd);
+}
+
+bool I2c_Executor::stop_motors()
+{
+	I2c_Command cmd = {I2c_CommandType::StopMotors, 0, 0, false, 0.0f, I2c_BrakeProfile(), nullptr};
+	return submit(cmd);
+}
+
+bool I2c_Executor::stop_all()
+{
+	I2c_Command cmd = {I2c_CommandType::StopAll, 0, 0, false, 0.0f, I2c_BrakeProfile(), nullptr};
+	return submit(cmd);
+}
+
+bool I2c_Executor::brake_motor(const I2c_BrakeProfile &profile)
+{
+	I2c_Command cmd = {I2c_CommandType::Brake, 0, 0, false, 0.0f, profile, nullptr};
+	return submit(cmd);
+}
+
+void I2c_Executor::emergency_stop()
+{
+	_estop.store(true);
+	wake();
+}
+
+void I2c_Executor::sync()
+{
+	std::atomic<bool> done(false);
+	I2c_Command cmd = {I2c_CommandType::Fence, 0, 0, false, 0.0f, I2c_BrakeProfile(), &done};
+
+	while (!_queue.push(cmd))
+		std::this_thread::yield();
+	wake();
+	while (!done.load(std::memory_order_acquire))
+		std::this_thread::yield();
+}
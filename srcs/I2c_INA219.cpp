@@ -1,6 +1,10 @@
 #include "../include/I2c_INA219.hpp"
+#include "../include/I2c_Log.hpp"
+#include "../include/I2c_Recorder.hpp"
 #include <cstdint>
 #include <iostream>
+#include <utility>
+#include <time.h>
 
 #define REG_CONFIG             0x00
 #define REG_SHUNT_VOLTAGE      0x01
@@ -9,139 +13,666 @@
 #define REG_CURRENT            0x04
 #define REG_CALIBRATION        0x05
 
- int 		I2c_INA219::status = 1;
- double  	I2c_INA219::_Voltage; // Volt 
- double 	I2c_INA219::_Current; // Ampere
- double 	I2c_INA219::_Power;    // watt
- uint8_t 	I2c_INA219::_addr;
- int 		I2c_INA219::fd;
- std::string  	I2c_INA219::_i2c_device;
+#define INA_SHUNT_LSB_UV       10
+#define INA_BUS_LSB_UV         4000
+#define INA_CAL_SCALE          40960000000000000ull  // 0.04096 in pA * uohm
 
-void I2c_INA219::writeRegister(int fd, uint8_t reg, uint16_t value) {
+void I2c_INA219_Device::writeRegister(uint8_t reg, uint16_t value) {
     uint8_t buffer[3];
     buffer[0] = reg;
     buffer[1] = (value >> 8) & 0xFF;
     buffer[2] = value & 0xFF;
-    if (write(fd, buffer, 3) != 3) {
+    if (_bus->write(buffer, 3, I2C_OP_WRITE_REGISTER) != 0) {
 	throw std::runtime_error("Erro ao escrever no registrador");
 
     }
 }
 
-uint16_t I2c_INA219::readRegister(int fd, uint8_t reg) {
-    if (write(fd, &reg, 1) != 1) {
+uint16_t I2c_INA219_Device::readRegister(uint8_t reg) {
+    uint16_t value;
+
+    if (readRegisters(&reg, &value, 1) != 0) {
+	throw std::runtime_error("Erro ao ler registrador");
+    }
+    return value;
+}
 
-	throw std::runtime_error("Erro ao selecionar registrador");
+// Pointer write + 2-byte read per register, joined by repeated starts and
+// sent as a single transaction where the adapter allows it (the transport
+// falls back to one per register otherwise). Returns 0 or -errno.
+int I2c_INA219_Device::readRegisters(const uint8_t *regs, uint16_t *values, size_t count) noexcept {
+    struct i2c_msg msgs[2 * 4];
+    uint8_t reg_buf[4];
+    uint8_t data[4][2];
+    int ret;
 
+    if (count > 4)
+        return -EINVAL;
+    for (size_t i = 0; i < count; ++i) {
+        reg_buf[i] = regs[i];
+        msgs[2 * i].flags = 0;
+        msgs[2 * i].len = 1;
+        msgs[2 * i].buf = &reg_buf[i];
+        msgs[2 * i + 1].flags = I2C_M_RD;
+        msgs[2 * i + 1].len = 2;
+        msgs[2 * i + 1].buf = data[i];
     }
-    uint8_t buffer[2];
-    if (read(fd, buffer, 2) != 2) {
+    if ((ret = _bus->transaction(msgs, 2 * count, I2C_OP_READ_REGISTER)) != 0)
+        return ret;
+    for (size_t i = 0; i < count; ++i)
+        values[i] = (data[i][0] << 8) | data[i][1];
+    return 0;
+}
 
+// Shunt, bus, current and power in one transaction if the adapter allows
+void I2c_INA219_Device::read_raw(I2c_INA219_Raw &raw)
+{
+    if (!try_read_raw(raw)) {
 	throw std::runtime_error("Erro ao ler registrador");
     }
-    return (buffer[0] << 8) | buffer[1];
 }
 
+I2c_Status I2c_INA219_Device::try_read_raw(I2c_INA219_Raw &raw) noexcept
+{
+    static const uint8_t regs[4] = {REG_SHUNT_VOLTAGE, REG_BUS_VOLTAGE, REG_CURRENT, REG_POWER};
+    uint16_t values[4];
+    int ret;
 
+    if ((ret = readRegisters(regs, values, 4)) != 0)
+        return I2c_Status::from_errno(ret);
+    raw.shunt = values[0];
+    raw.bus = values[1];
+    raw.current = values[2];
+    raw.power = values[3];
+    return I2c_Status();
+}
 
-void I2c_INA219::init( uint8_t addr,std::string i2c_device)
+bool I2c_INA219_Device::read_raw_if_ready(I2c_INA219_Raw &raw)
 {
+    // Power last: reading it clears CNVR for the conversion just fetched
+    static const uint8_t regs[3] = {REG_SHUNT_VOLTAGE, REG_CURRENT, REG_POWER};
+    uint16_t values[3];
 
-if (fd >= 0) close(fd);
+    raw.bus = readRegister(REG_BUS_VOLTAGE);
+    if (!raw.ready())
+        return false;
+    if (readRegisters(regs, values, 3) != 0) {
+	throw std::runtime_error("Erro ao ler registrador");
+    }
+    raw.shunt = values[0];
+    raw.current = values[1];
+    raw.power = values[2];
+    // Triggered modes convert once per config write
+    if (_config.triggered())
+        writeRegister(REG_CONFIG, _config.reg());
+    return true;
+}
 
-   if(status == 1)
+uint16_t I2c_INA219_Config::reg() const
+{
+    return ((uint16_t)bus_range << 13) | ((uint16_t)gain << 11) | ((uint16_t)bus_adc << 7)
+        | ((uint16_t)shunt_adc << 3) | (uint16_t)mode;
+}
+
+// Datasheet conversion time of one ADC setting
+static uint32_t adc_time_us(I2c_INA219_Adc adc)
+{
+    static const uint32_t resolution[4] = {84, 148, 276, 532};
+    static const uint32_t averaging[8] = {532, 1060, 2130, 4260, 8510, 17020, 34050, 68100};
+    unsigned code = (unsigned)adc;
+
+    if (code & 0x8)
+        return averaging[code & 0x7];
+    return resolution[code & 0x3];
+}
+
+uint32_t I2c_INA219_Config::conversion_us() const
+{
+    unsigned m = (unsigned)mode;
+    uint32_t t = 0;
+
+    if (m == 0 || m == 4)
+        return 0;
+    if (m & 0x1)
+        t += adc_time_us(shunt_adc);
+    if (m & 0x2)
+        t += adc_time_us(bus_adc);
+    return t;
+}
+
+bool I2c_INA219_Config::triggered() const
+{
+    return (unsigned)mode >= 1 && (unsigned)mode <= 3;
+}
+
+// Datasheet: Cal = 0.04096 / (Current_LSB * Rshunt), Current_LSB = Imax / 2^15
+void I2c_INA219_Config::calibrate(uint32_t shunt, uint32_t max_current_ma)
+{
+    static const uint32_t range_uv[4] = {40000, 80000, 160000, 320000};
+    uint64_t shunt_max_uv = (uint64_t)max_current_ma * shunt / 1000;
+    uint64_t lsb_pa;
+    uint64_t cal;
+    int g = 0;
+
+    if (shunt == 0 || max_current_ma == 0)
+        throw std::runtime_error("Invalid INA219 shunt or current range");
+    while (g < 4 && range_uv[g] < shunt_max_uv)
+        g++;
+    if (g == 4)
+        throw std::runtime_error("INA219 shunt voltage above the 320 mV range");
+
+    lsb_pa = ((uint64_t)max_current_ma * 1000000000ull + 32767) / 32768;
+    cal = INA_CAL_SCALE / (lsb_pa * shunt);
+    if (cal == 0 || cal > 0xFFFE)
+        throw std::runtime_error("INA219 calibration out of range");
+
+    gain = (I2c_INA219_Gain)g;
+    shunt_uohm = shunt;
+    calibration = cal & 0xFFFE;  // bit 0 does not exist on the chip
+}
+
+// The LSB the chip actually uses with the (truncated) calibration value
+uint64_t I2c_INA219_Config::current_lsb_pa() const
+{
+    if (calibration == 0 || shunt_uohm == 0)
+        return 0;
+    return INA_CAL_SCALE / ((uint64_t)calibration * shunt_uohm);
+}
+
+I2c_INA219_Device::I2c_INA219_Device(std::unique_ptr<I2c_Transport> bus)
+    : _bus(std::move(bus)), _current_lsb_pa(_config.current_lsb_pa()), _sampler_run(false), _sampler_errors(0),
+      _sampler_rate(0), _ready_ns(0)
+{
+}
+
+I2c_INA219_Device::I2c_INA219_Device(const std::string &i2c_device, uint8_t addr)
+    : _bus(new I2c_DevTransport(i2c_device, addr)), _current_lsb_pa(_config.current_lsb_pa()),
+      _sampler_run(false), _sampler_errors(0), _sampler_rate(0), _ready_ns(0)
+{
+}
+
+I2c_INA219_Device::~I2c_INA219_Device()
+{
+    stop_sampler();
+}
+
+void I2c_INA219_Device::init(const I2c_INA219_Config &config)
+{
+    configure(config);
+
+usleep(10000);
+}
+
+// Writing the config register restarts the conversion in progress. The
+// sampler reads _config and the LSBs in convert(): it is stopped meanwhile
+// so no sample mixes the old and new scales.
+void I2c_INA219_Device::configure(const I2c_INA219_Config &config)
+{
+    double rate = sampler_running() ? _sampler_rate : 0;
+
+    stop_sampler();
+    try {
+        writeRegister(REG_CONFIG, config.reg());
+        writeRegister(REG_CALIBRATION, config.calibration);
+    } catch (...) {
+        if (rate > 0)
+            start_sampler(rate);
+        throw;
+    }
+    _config = config;
+    _current_lsb_pa = config.current_lsb_pa();
+    if (rate > 0)
+        start_sampler(rate);
+}
+
+const I2c_INA219_Config &I2c_INA219_Device::config() const
+{
+    return _config;
+}
+
+
+
+static uint64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Integer only; the LSBs come from the calibration set in configure()
+void I2c_INA219_Device::convert(const I2c_INA219_Raw &raw, I2c_INA219_Sample &out) const
+{
+    // Bus voltage: deslocar 3 bits e aplicar máscara de 13 bits
+    out.timestamp_ns = monotonic_ns();
+    out.shunt_uv = (int16_t)raw.shunt * INA_SHUNT_LSB_UV;
+    out.bus_uv = ((raw.bus >> 3) & 0x1FFF) * INA_BUS_LSB_UV;
+    out.current_ua = (int32_t)((int64_t)(int16_t)raw.current * (int64_t)_current_lsb_pa / 1000000);
+    out.power_uw = (uint32_t)((uint64_t)raw.power * 20 * _current_lsb_pa / 1000000);
+    out.voltage = out.bus_uv * 1e-6;
+    out.shunt_voltage = out.shunt_uv * 1e-6;
+    out.current = out.current_ua * 1e-3;
+    out.power = out.power_uw * 1e-3;
+    out.raw = raw;
+}
+
+// Reads one sample from the chip and converts it, without printing
+void I2c_INA219_Device::sample(I2c_INA219_Sample &out)
+{
+    I2c_INA219_Raw raw;
+    read_raw(raw);
+    convert(raw, out);
+}
+
+I2c_Result<I2c_INA219_Sample> I2c_INA219_Device::try_sample() noexcept
+{
+    I2c_INA219_Raw raw;
+    I2c_INA219_Sample s;
+    I2c_Status status = try_read_raw(raw);
+
+    if (!status)
+        return status.error();
+    convert(raw, s);
+    return s;
+}
+
+bool I2c_INA219_Device::sample_if_ready(I2c_INA219_Sample &out)
+{
+    I2c_INA219_Raw raw;
+    if (!read_raw_if_ready(raw))
+        return false;
+    convert(raw, out);
+    return true;
+}
+
+// Reads and publishes a sample. While the sampler runs it owns the bus:
+// the last published sample is returned instead
+I2c_INA219_Sample I2c_INA219_Device::update()
+{
+    I2c_INA219_Sample s;
+
+    if (_sampler_run.load(std::memory_order_relaxed))
+        return _snapshot.load();
+    sample(s);
+    publish(s);
+    return s;
+}
+
+// Again while the sampler has not published anything yet
+I2c_Result<I2c_INA219_Sample> I2c_INA219_Device::try_update() noexcept
+{
+    if (_sampler_run.load(std::memory_order_relaxed))
     {
-	_addr = addr;
-	_i2c_device = i2c_device;
-	status = 0;
+        I2c_INA219_Sample s = _snapshot.load();
+        if (!s.timestamp_ns)
+            return I2c_Error::Again;
+        return s;
     }
-    fd = open(_i2c_device.c_str(), O_RDWR);
-    if (fd < 0) {
-        perror("Erro ao abrir barramento I2C");
-        close(fd);
-        throw std::runtime_error( "Erro ao abrir barramento I2C");
+    I2c_Result<I2c_INA219_Sample> r = try_sample();
+    if (r)
+        publish(*r);
+    return r;
+}
+
+// Same, only when the chip finished a new conversion, so repeated calls
+// never return the same conversion twice. While the sampler runs: only
+// when it published a sample this function has not returned yet
+bool I2c_INA219_Device::update_if_ready(I2c_INA219_Sample &out)
+{
+    if (_sampler_run.load(std::memory_order_relaxed))
+    {
+        I2c_INA219_Sample s = _snapshot.load();
+        if (!s.timestamp_ns || _ready_ns.exchange(s.timestamp_ns, std::memory_order_relaxed) == s.timestamp_ns)
+            return false;
+        out = s;
+        return true;
     }
+    if (!sample_if_ready(out))
+        return false;
+    publish(out);
+    return true;
+}
+
+// Makes a new sample visible to snapshot(), history() and stats()
+void I2c_INA219_Device::publish(const I2c_INA219_Sample &s)
+{
+    I2c_INA219_Stats st;
 
-    if (ioctl(fd, I2C_SLAVE, _addr) < 0) {
-        close(fd);
-        throw std::runtime_error("Failed to set I2C address-INA219");
+    _history.push(s);
+    _stats_voltage.push(s.voltage);
+    _stats_current.push(s.current);
+    _stats_power.push(s.power);
+    st.voltage = _stats_voltage.stats();
+    st.current = _stats_current.stats();
+    st.power = _stats_power.stats();
+    _stats.store(st);
+    if (I2c_Recorder *rec = _bus->recorder())
+    {
+        I2c_RecordSample r = {s.bus_uv, s.shunt_uv, s.current_ua, s.power_uw,
+                              {s.raw.shunt, s.raw.bus, s.raw.current, s.raw.power}};
+        rec->sample(_bus->recorder_device(), s.timestamp_ns, r);
     }
+    _battery.update(s.timestamp_ns, s.voltage, s.current);
+    _battery_state.store(_battery.state());
+    _snapshot.store(s);
+}
+
+// Latest values: from the sampler when it runs, otherwise from the bus
+I2c_INA219_Sample I2c_INA219_Device::latest()
+{
+    if (!_sampler_run.load(std::memory_order_relaxed))
+        return update();
+    return _snapshot.load();
+}
 
-	 uint16_t config = 0x19FF;
-    writeRegister(fd, REG_CONFIG, config);
+int I2c_INA219_Device::value_batery()
+{
+	return battery_percent(latest().voltage);
+}
 
-    uint16_t calibration = 4096;;
-    writeRegister(fd, REG_CALIBRATION, calibration);
+int I2c_INA219_Device::battery_percent(double voltage)
+{
+	int ret;
+	float max = 12.5;
+	float min = 10;
 
-usleep(10000);
+	ret = ((voltage - min)/(max - min))* 100;
+		if(ret > 100)
+			ret =100;
+	return (ret);
 }
 
+// =============================================================================
+// Background sampler
+// =============================================================================
 
+void I2c_INA219_Device::sampler_loop(double rate_hz)
+{
+    uint64_t period_ns = (uint64_t)(1000000000.0 / rate_hz);
+    struct timespec next;
 
-void I2c_INA219::update_values()
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (_sampler_run.load(std::memory_order_relaxed))
+    {
+        try
+        {
+            I2c_INA219_Sample s;
+            if (sample_if_ready(s))
+                publish(s);
+        }
+        catch(std::exception &e)
+        {
+            uint32_t errors = _sampler_errors.fetch_add(1, std::memory_order_relaxed) + 1;
+            I2c_Log::log(I2c_LogLevel::Warn, I2c_LogEvent::Ina219SamplerError, 1, errors);
+        }
+        next.tv_nsec += period_ns % 1000000000ull;
+        next.tv_sec += period_ns / 1000000000ull + next.tv_nsec / 1000000000;
+        next.tv_nsec %= 1000000000;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+    }
+}
+
+void I2c_INA219_Device::start_sampler(double rate_hz)
+{
+    if (rate_hz <= 0)
+        throw std::runtime_error("Invalid INA219 sample rate");
+    stop_sampler();
+    _sampler_rate = rate_hz;
+    _sampler_run = true;
+    _sampler = std::thread(&I2c_INA219_Device::sampler_loop, this, rate_hz);
+}
+
+void I2c_INA219_Device::stop_sampler()
+{
+    _sampler_run = false;
+    if (_sampler.joinable())
+        _sampler.join();
+}
+
+// Lock-free, never touches the bus
+I2c_INA219_Sample I2c_INA219_Device::snapshot() const
 {
+    return _snapshot.load();
+}
+
+// =============================================================================
+// History
+// =============================================================================
+
+// Only while nothing publishes (sampler stopped); clears the statistics
+void I2c_INA219_Device::configure_stats(size_t window, double ewma_alpha)
+{
+    _stats_voltage.configure(window, ewma_alpha);
+    _stats_current.configure(window, ewma_alpha);
+    _stats_power.configure(window, ewma_alpha);
+    _stats.store(I2c_INA219_Stats());
+}
+
+I2c_INA219_Stats I2c_INA219_Device::stats() const
+{
+    return _stats.load();
+}
+
+void I2c_INA219_Device::configure_battery(const I2c_BatteryConfig &config)
+{
+    _battery.configure(config);
+    _battery_state.store(_battery.state());
+}
+
+void I2c_INA219_Device::reset_battery(double soc, double soc_std)
+{
+    _battery.reset(soc, soc_std);
+    _battery_state.store(_battery.state());
+}
+
+I2c_BatteryState I2c_INA219_Device::battery() const
+{
+    return _battery_state.load();
+}
+
+uint64_t I2c_INA219_Device::history(I2c_Span<I2c_INA219_Sample> &first, I2c_Span<I2c_INA219_Sample> &second) const
+{
+    return _history.view(first, second);
+}
+
+bool I2c_INA219_Device::history_overwritten(uint64_t seq) const
+{
+    return _history.overwritten(seq);
+}
+
+uint32_t I2c_INA219_Device::sampler_errors() const
+{
+    return _sampler_errors.load(std::memory_order_relaxed);
+}
+
+bool I2c_INA219_Device::sampler_running() const
+{
+    return _sampler_run.load(std::memory_order_relaxed);
+}
+
+// =============================================================================
+// Static API over the car's sensor
+// =============================================================================
+
+ int 		I2c_INA219::status = 1;
+ double  	I2c_INA219::_Voltage; // Volt 
+ double 	I2c_INA219::_Current; // Ampere
+ double 	I2c_INA219::_Power;    // watt
+ uint8_t 	I2c_INA219::_addr;
+ std::string  	I2c_INA219::_i2c_device;
+ std::unique_ptr<I2c_INA219_Device> I2c_INA219::_dev;
+
+void I2c_INA219::init( uint8_t addr,std::string i2c_device)
+{
+   close_();
+
+   if(status == 1)
+    {
+	_addr = addr;
+	_i2c_device = i2c_device;
+	status = 0;
+    }
     try
     {
-        // ===== Leitura =====
-        uint16_t shunt_raw = readRegister(fd, REG_SHUNT_VOLTAGE);
-        uint16_t bus_raw = readRegister(fd, REG_BUS_VOLTAGE);
-        uint16_t current_raw = readRegister(fd, REG_CURRENT);
-        uint16_t power_raw = readRegister(fd, REG_POWER);
-        
-        std::cout << "Bus raw = 0x" << std::hex << bus_raw << std::dec << std::endl;
-        
-        // Shunt voltage: LSB = 10µV
-        double shunt_voltage = (int16_t)shunt_raw * 0.00001; // V (10 µV/bit)
-        
-        // Bus voltage: deslocar 3 bits e aplicar máscara de 13 bits
-        // LSB = 4mV = 0.004V
-        double bus_voltage = ((bus_raw >> 3) & 0x1FFF) * 0.0045; // V
-        
-        std::cout << "Bus voltage = " << bus_voltage << " V, Shunt voltage = " << shunt_voltage << " V" << std::endl;
-        
-        _Voltage = bus_voltage; // tensão total (VIN+)
-        _Current = (int16_t)current_raw * 0.0978;  // mA (depende da calibração)
-        _Power   = power_raw * 1.956;              // mW (depende da calibração)
+        init(std::unique_ptr<I2c_Transport>(new I2c_DevTransport(_i2c_device, _addr)));
     }
     catch(std::exception &e)
     {
-        std::cout << "Failed to update values: " << e.what() << std::endl;
+        I2c_Log::log(I2c_LogLevel::Error, I2c_LogEvent::Ina219OpenFailed);
+        throw;
+    }
+}
+
+void I2c_INA219::init(std::unique_ptr<I2c_Transport> bus, const I2c_INA219_Config &config)
+{
+    _dev.reset(new I2c_INA219_Device(std::move(bus)));
+    _dev->init(config);
+}
+
+void I2c_INA219::configure(const I2c_INA219_Config &config)
+{
+    _dev->configure(config);
+}
+
+const I2c_INA219_Config &I2c_INA219::config()
+{
+    return _dev->config();
+}
+
+void I2c_INA219::update_values()
+{
+    // ===== Leitura =====
+    I2c_Result<I2c_INA219_Sample> r = _dev->try_update();
+
+    if (!r)
+    {
+        I2c_Log::log(I2c_LogLevel::Warn, I2c_LogEvent::Ina219ReadFailed, 1, (int)r.error());
         return;
     }
+    I2c_Log::log(I2c_LogLevel::Info, I2c_LogEvent::Ina219Sample, 3, r->raw.bus, r->voltage, r->shunt_voltage);
+
+    _Voltage = r->voltage; // tensão total (VIN+)
+    _Current = r->current;
+    _Power   = r->power;
 }
 
-void I2c_INA219::print()
+// Reads and publishes without printing or throwing
+I2c_Status I2c_INA219::try_update_values() noexcept
+{
+    I2c_Result<I2c_INA219_Sample> r = _dev->try_update();
+
+    if (!r)
+        return r.error();
+    _Voltage = r->voltage; // tensão total (VIN+)
+    _Current = r->current;
+    _Power   = r->power;
+    return I2c_Status();
+}
+
+void I2c_INA219::read_raw(I2c_INA219_Raw &raw)
+{
+    _dev->read_raw(raw);
+}
+
+bool I2c_INA219::read_raw_if_ready(I2c_INA219_Raw &raw)
+{
+    return _dev->read_raw_if_ready(raw);
+}
+
+bool I2c_INA219::update_if_ready()
 {
-	int value = 	value_batery();
+    I2c_INA219_Sample s;
 
-    std::cout << "==========================" << std::endl;
-    std::cout << "INA219 - finich write" << std::endl;
-    std::cout << "--------------------------" << std::endl;
-    std::cout << "Voltage (Vbus): " << _Voltage << " V" << std::endl;
-    std::cout << "Current: " << _Current << " mA" << std::endl;
-    std::cout << "Power: " << _Power << " mW" << std::endl;
-    std::cout << "Percentage: " << value<<  std::endl;
-    std::cout << "==========================" << std::endl;
+    if (!_dev->update_if_ready(s))
+        return false;
+    _Voltage = s.voltage;
+    _Current = s.current;
+    _Power   = s.power;
+    return true;
 }
 
+// Latest values: from the sampler when it runs, otherwise from the bus
+I2c_INA219_Sample I2c_INA219::latest()
+{
+    if (!_dev->sampler_running())
+        update_values();
+    return _dev->snapshot();
+}
+
+void I2c_INA219::print()
+{
+	I2c_INA219_Sample s = latest();
+	int value = 	I2c_INA219_Device::battery_percent(s.voltage);
+
+    I2c_Log::log(I2c_LogLevel::Info, I2c_LogEvent::Ina219Report, 4, s.voltage, s.current, s.power, value);
+}
 
 int  I2c_INA219::value_batery()
 {
-	I2c_INA219::update_values();
-	int ret;
-	float max = 12.5;
-	float min = 10;
+	return I2c_INA219_Device::battery_percent(latest().voltage);
 
-	ret = ((_Voltage - min)/(max - min))* 100;
-		if(ret > 100)
-			ret =100;
-	return (ret);
+}
 
+void I2c_INA219::start_sampler(double rate_hz)
+{
+    _dev->start_sampler(rate_hz);
 }
 
-void I2c_INA219::close_()
+void I2c_INA219::stop_sampler()
 {
-	close(fd);
+    _dev->stop_sampler();
 }
 
+I2c_INA219_Sample I2c_INA219::snapshot()
+{
+    return _dev->snapshot();
+}
 
+uint32_t I2c_INA219::sampler_errors()
+{
+    return _dev->sampler_errors();
+}
+
+uint64_t I2c_INA219::history(I2c_Span<I2c_INA219_Sample> &first, I2c_Span<I2c_INA219_Sample> &second)
+{
+    return _dev->history(first, second);
+}
+
+bool I2c_INA219::history_overwritten(uint64_t seq)
+{
+    return _dev->history_overwritten(seq);
+}
+
+void I2c_INA219::configure_stats(size_t window, double ewma_alpha)
+{
+    _dev->configure_stats(window, ewma_alpha);
+}
+
+I2c_INA219_Stats I2c_INA219::stats()
+{
+    return _dev->stats();
+}
+
+void I2c_INA219::configure_battery(const I2c_BatteryConfig &config)
+{
+    _dev->configure_battery(config);
+}
+
+void I2c_INA219::reset_battery(double soc, double soc_std)
+{
+    _dev->reset_battery(soc, soc_std);
+}
+
+I2c_BatteryState I2c_INA219::battery()
+{
+    return _dev->battery();
+}
+
+I2c_INA219_Device &I2c_INA219::device()
+{
+    return *_dev;
+}
+
+void I2c_INA219::close_()
+{
+	_dev.reset();
+}
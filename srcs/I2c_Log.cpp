@@ -0,0 +1,238 @@
+#include "../include/I2c_Log.hpp"
+#include "../include/I2c_Result.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_BUFFER	65536	// bytes formatted per write()
+
+std::atomic<uint8_t> I2c_Log::_level((uint8_t)I2c_LogLevel::Info);
+std::atomic<bool> I2c_Log::_started(false);
+std::atomic<bool> I2c_Log::_run(false);
+std::atomic<uint64_t> I2c_Log::_dropped(0);
+std::atomic<uint64_t> I2c_Log::_written(0);
+I2c_MpscQueue<I2c_LogRecord, I2C_LOG_CAPACITY> I2c_Log::_queue;
+I2c_LogConfig I2c_Log::_config;
+std::thread I2c_Log::_writer;
+
+static std::mutex log_control;  // start()/stop(); log() only until the writer runs
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// One syscall per thread, then cached
+static uint32_t thread_id()
+{
+	static thread_local uint32_t tid = 0;
+
+	if (tid == 0)
+		tid = (uint32_t)syscall(SYS_gettid);
+	return tid;
+}
+
+void I2c_Log::log(I2c_LogLevel level, I2c_LogEvent event, size_t nargs, double a0, double a1, double a2, double a3)
+{
+	I2c_LogRecord r;
+
+	if (!enabled(level))
+		return;
+	if (!_started.load(std::memory_order_acquire)) {
+		std::lock_guard<std::mutex> lock(log_control);
+		if (!_started.load(std::memory_order_relaxed))
+			start_locked(_config);
+	}
+	r.timestamp_ns = monotonic_ns();
+	r.event = (uint16_t)event;
+	r.level = (uint8_t)level;
+	r.nargs = nargs < I2C_LOG_ARGS ? nargs : I2C_LOG_ARGS;
+	r.thread = thread_id();
+	r.args[0] = a0;
+	r.args[1] = a1;
+	r.args[2] = a2;
+	r.args[3] = a3;
+	if (!_queue.push(r))
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void I2c_Log::set_level(I2c_LogLevel level)
+{
+	_level.store((uint8_t)level, std::memory_order_relaxed);
+}
+
+I2c_LogLevel I2c_Log::level()
+{
+	return (I2c_LogLevel)_level.load(std::memory_order_relaxed);
+}
+
+static void stop_at_exit()
+{
+	I2c_Log::stop();
+}
+
+void I2c_Log::start(const I2c_LogConfig &config)
+{
+	std::lock_guard<std::mutex> lock(log_control);
+
+	stop_locked();
+	start_locked(config);
+}
+
+void I2c_Log::stop()
+{
+	std::lock_guard<std::mutex> lock(log_control);
+
+	stop_locked();
+}
+
+void I2c_Log::start_locked(const I2c_LogConfig &config)
+{
+	static bool registered = false;
+
+	_config = config;
+	_level.store((uint8_t)config.level, std::memory_order_relaxed);
+	if (config.format == I2c_LogFormat::Binary) {
+		if (write(config.fd, I2C_LOG_MAGIC, sizeof(I2C_LOG_MAGIC) - 1) < 0) {
+			// Nothing better to do than keep going
+		}
+	}
+	_run.store(true, std::memory_order_relaxed);
+	_writer = std::thread(&I2c_Log::loop);
+	_started.store(true, std::memory_order_release);
+	if (!registered) {
+		registered = true;
+		atexit(stop_at_exit);
+	}
+}
+
+void I2c_Log::stop_locked()
+{
+	if (!_started.load(std::memory_order_acquire))
+		return;
+	_run.store(false, std::memory_order_relaxed);
+	if (_writer.joinable())
+		_writer.join();
+	_started.store(false, std::memory_order_release);
+}
+
+// Pops and formats records into buf until it is nearly full or the ring
+// is empty; returns the bytes to write
+size_t I2c_Log::drain(char *buf, size_t cap)
+{
+	I2c_LogRecord r;
+	size_t len = 0;
+
+	while (cap - len > 512 && _queue.pop(r)) {
+		if (_config.format == I2c_LogFormat::Binary) {
+			memcpy(buf + len, &r, sizeof(r));
+			len += sizeof(r);
+		} else {
+			len += format(r, buf + len, cap - len - 1);
+			buf[len++] = '\n';
+		}
+		_written.fetch_add(1, std::memory_order_relaxed);
+	}
+	return len;
+}
+
+void I2c_Log::loop()
+{
+	static char buf[LOG_BUFFER];
+	struct timespec period;
+	bool running = true;
+	uint32_t ms = _config.flush_ms ? _config.flush_ms : 1;
+
+	period.tv_sec = ms / 1000;
+	period.tv_nsec = (long)(ms % 1000) * 1000000;
+	while (running) {
+		size_t len;
+
+		// Read the flag first so records logged before stop() are drained
+		running = _run.load(std::memory_order_relaxed);
+		while ((len = drain(buf, sizeof(buf))) > 0) {
+			size_t off = 0;
+			while (off < len) {
+				ssize_t n = write(_config.fd, buf + off, len - off);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+					break;
+				off += n;
+			}
+		}
+		if (running)
+			nanosleep(&period, nullptr);
+	}
+}
+
+const char *I2c_Log::level_name(I2c_LogLevel level)
+{
+	static const char *names[] = {"DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+	return (size_t)level < 5 ? names[(size_t)level] : "?";
+}
+
+const char *I2c_Log::event_name(I2c_LogEvent event)
+{
+	static const char *names[(size_t)I2c_LogEvent::Count] = {
+		"message", "ina219_sample", "ina219_read_failed", "ina219_report",
+		"ina219_sampler_error", "ina219_open_failed", "watchdog_trip", "executor_error",
+	};
+	return (size_t)event < (size_t)I2c_LogEvent::Count ? names[(size_t)event] : "?";
+}
+
+size_t I2c_Log::format(const I2c_LogRecord &r, char *buf, size_t cap)
+{
+	const double *a = r.args;
+	int n;
+	int m = 0;
+
+	n = snprintf(buf, cap, "[%6lu.%06lu] %-5s %s: ", (unsigned long)(r.timestamp_ns / 1000000000ull),
+		     (unsigned long)(r.timestamp_ns % 1000000000ull / 1000), level_name((I2c_LogLevel)r.level),
+		     event_name((I2c_LogEvent)r.event));
+	if (n < 0 || (size_t)n >= cap)
+		return cap ? cap - 1 : 0;
+	switch ((I2c_LogEvent)r.event) {
+	case I2c_LogEvent::Ina219Sample:
+		m = snprintf(buf + n, cap - n, "Bus raw = 0x%x, Bus voltage = %g V, Shunt voltage = %g V",
+			     (unsigned)a[0], a[1], a[2]);
+		break;
+	case I2c_LogEvent::Ina219ReadFailed:
+		m = snprintf(buf + n, cap - n, "Failed to update values: %s", I2c_error_name((I2c_Error)(int)a[0]));
+		break;
+	case I2c_LogEvent::Ina219Report:
+		m = snprintf(buf + n, cap - n, "Voltage (Vbus): %g V, Current: %g mA, Power: %g mW, Percentage: %d",
+			     a[0], a[1], a[2], (int)a[3]);
+		break;
+	case I2c_LogEvent::Ina219SamplerError:
+		m = snprintf(buf + n, cap - n, "sampler read failed (%lu so far)", (unsigned long)a[0]);
+		break;
+	case I2c_LogEvent::Ina219OpenFailed:
+		m = snprintf(buf + n, cap - n, "Erro ao abrir barramento I2C");
+		break;
+	case I2c_LogEvent::WatchdogTrip:
+		m = snprintf(buf + n, cap - n, "motors stopped %.0f us after the deadline (trip %lu)",
+			     a[0] / 1000, (unsigned long)a[1]);
+		break;
+	case I2c_LogEvent::ExecutorError:
+		if (a[0] < 0)
+			m = snprintf(buf + n, cap - n, "emergency stop failed (%lu errors so far)", (unsigned long)a[1]);
+		else
+			m = snprintf(buf + n, cap - n, "command %d failed (%lu errors so far)", (int)a[0], (unsigned long)a[1]);
+		break;
+	default:
+		for (size_t i = 0; i < r.nargs && i < I2C_LOG_ARGS && (size_t)(n + m) < cap; ++i)
+			m += snprintf(buf + n + m, cap - n - m, i ? " %g" : "%g", a[i]);
+		break;
+	}
+	if (m < 0)
+		m = 0;
+	return (size_t)(n + m) < cap ? n + m : cap - 1;
+}
@@ -1,197 +1,608 @@
 #include "../include/I2c_PcA9685.hpp"
+#include "../include/I2c_Watchdog.hpp"
+#include "../include/I2c_Recorder.hpp"
 #include <stdint.h>
+#include <cstring>
+#include <cmath>
 
 #include <cstdint>
 
 #include <cstdint>
+#include <utility>
+#include <cerrno>
+#include <time.h>
 
+#define PCA_MODE1		0x00
+#define PCA_MODE2		0x01
+#define PCA_LED0_ON_L		0x06
+#define PCA_ALL_LED_OFF_H	0xFD
+#define PCA_PRE_SCALE		0xFE
 
-int I2c_PcA9685::_fd_mot = 0;
-int I2c_PcA9685::_fd_servo = 0;
-int I2c_PcA9685::_fd_set = 0;
-float I2c_PcA9685::_SERVO_MIN_PULSE_MS = 0.5f;
-float I2c_PcA9685::_SERVO_MAX_PULSE_MS = 2.5f;
-float I2c_PcA9685::_SERVO_FREQ = 50.0f;
+#define PCA_MODE1_RESTART	0x80
+#define PCA_MODE1_AI		0x20
+#define PCA_MODE1_SLEEP		0x10
 
-void I2c_PcA9685::init(uint8_t addr_mot, uint8_t addr_servo,std::string i2c_device)
+#define PCA_CHANNELS		16
+#define PCA_FULL_OFF		0x1000	// bit 4 of LEDn_OFF_H, overrides ON/OFF
+#define PCA_OSC_WAKE_NS		500000	// oscillator start-up after SLEEP is cleared
+// Cost of one more transaction in bytes on the wire: START, address,
+// register, STOP, plus the syscall and adapter set-up (~10 byte times at 100 kHz)
+#define PCA_TXN_OVERHEAD	10
+
+
+float I2c_PcA9685_Device::_SERVO_FREQ = 50.0f;
+
+I2c_PcA9685_Device::I2c_PcA9685_Device(std::unique_ptr<I2c_Transport> bus)
+	: _bus(std::move(bus)), _shadow(), _wake_ns(0), _brake(), _brake_start(0), _braking(false),
+	  _stale(false)
 {
-	int prescaler = 121;
-	
-	if ((_fd_mot = open(i2c_device.c_str(), O_RDWR)) < 0) {
-            throw std::runtime_error("Failed to open I2C device");
-        }
-        if (ioctl(_fd_mot, I2C_SLAVE, addr_mot ) < 0) {
-            throw std::runtime_error("Failed to set I2C address");
-        }
+}
 
-	if ((_fd_servo = open(i2c_device.c_str(), O_RDWR)) < 0) {
-            throw std::runtime_error("Failed to open I2C device");
-        }
-        if (ioctl(_fd_servo, I2C_SLAVE, addr_servo ) < 0) {
-            throw std::runtime_error("Failed to set I2C address");
-        }
+I2c_PcA9685_Device::I2c_PcA9685_Device(const std::string &i2c_device, uint8_t addr)
+	: _bus(new I2c_DevTransport(i2c_device, addr)), _shadow(), _wake_ns(0), _brake(), _brake_start(0),
+	  _braking(false), _stale(false)
+{
+}
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void I2c_PcA9685_Device::init(uint8_t prescaler)
+{
+	init_begin(prescaler);
+	init_finish();
+}
+
+// Programs the board and starts its oscillator. init_finish() completes the
+// restart once the oscillator is stable, so several boards can be started
+// first and share a single wait.
+void I2c_PcA9685_Device::init_begin(uint8_t prescaler)
+{
+	write_byte(PCA_MODE1, PCA_MODE1_AI | PCA_MODE1_SLEEP); // MODE1 sleep, auto-increment
+	write_byte(PCA_MODE2, 0x04); // MODE2 totem pole
+	write_byte(PCA_PRE_SCALE, prescaler); // Set prescaler (only while asleep)
+	write_byte(PCA_MODE1, PCA_MODE1_AI); // Wake up the oscillator
+	_wake_ns = monotonic_ns();
+	invalidate_cache();
+}
+
+void I2c_PcA9685_Device::init_finish()
+{
+	uint64_t ready = _wake_ns + PCA_OSC_WAKE_NS;
+	uint64_t now = monotonic_ns();
+
+	if (now < ready) {
+		struct timespec ts = {0, (long)(ready - now)};
+		nanosleep(&ts, nullptr);
+	}
+	write_byte(PCA_MODE1, PCA_MODE1_RESTART | PCA_MODE1_AI); // Restart PWM, keep AI
+}
 
-	_fd_set = _fd_mot;
- 	write_byte(0x00, 0x00); // MODE1 normal
-        usleep(5000);
-        write_byte(0x01, 0x04); // MODE2 totem pole
-        usleep(5000);
-        write_byte(0x00, 0x10); // MODE1 sleep
-        usleep(5000);
-        write_byte(0xFE, prescaler); // Set prescaler
-        usleep(5000);
-        write_byte(0x00, 0x80); // Exit sleep
-        usleep(5000);
-	_fd_set = _fd_servo;
- 	write_byte(0x00, 0x00); // MODE1 normal
-        usleep(5000);
-        write_byte(0x01, 0x04); // MODE2 totem pole
-        usleep(5000);
-        write_byte(0x00, 0x10); // MODE1 sleep
-        usleep(5000);
-        write_byte(0xFE, prescaler); // Set prescaler
-        usleep(5000);
-        write_byte(0x00, 0x80); // Exit sleep
-        usleep(5000);
-	_fd_set = 0;
-}
-
-
-void I2c_PcA9685::write_byte(uint8_t reg, uint8_t val) {
+// True when MODE1/MODE2/PRE_SCALE already hold what init() would write
+bool I2c_PcA9685_Device::configured(uint8_t prescaler)
+{
+	uint8_t mode[2];
+	uint8_t pre;
+
+	read_block(PCA_MODE1, mode, 2);
+	read_block(PCA_PRE_SCALE, &pre, 1);
+	return (mode[0] & (PCA_MODE1_AI | PCA_MODE1_SLEEP)) == PCA_MODE1_AI
+		&& mode[1] == 0x04 && pre == prescaler;
+}
+
+// Warm start: if the board is already configured, keeps it running as is
+// and loads the channel registers into the shadow. False if it is not.
+bool I2c_PcA9685_Device::resume(uint8_t prescaler)
+{
+	uint8_t data[4 * PCA_CHANNELS];
+
+	if (!configured(prescaler))
+		return false;
+	read_block(PCA_LED0_ON_L, data, sizeof(data));
+	for (int ch = 0; ch < PCA_CHANNELS; ++ch) {
+		_shadow.on[ch] = data[4 * ch] | (data[4 * ch + 1] << 8);
+		_shadow.off[ch] = data[4 * ch + 2] | (data[4 * ch + 3] << 8);
+	}
+	_shadow.valid = 0xFFFF;
+	_shadow.dirty = 0;
+	return true;
+}
+
+// Returns true if the board was left running, false if it was reprogrammed
+bool I2c_PcA9685_Device::warm_init(uint8_t prescaler)
+{
+	if (resume(prescaler))
+		return true;
+	init(prescaler);
+	return false;
+}
+
+void I2c_PcA9685_Device::write_byte(uint8_t reg, uint8_t val) {
         uint8_t buffer[2] = {reg, val};
-        if (write(_fd_set, buffer, 2) != 2) {
+        if (_bus->write(buffer, 2, I2C_OP_WRITE_BYTE) != 0) {
             throw std::runtime_error("Failed to write I2C byte");
         }
     }
 
-void I2c_PcA9685::set_pwm(uint8_t channel, uint16_t on, uint16_t off) {
-        uint8_t reg_base = 0x06 + 4 * channel;
-        write_byte(reg_base, on & 0xFF);
-        write_byte(reg_base + 1, on >> 8);
-        write_byte(reg_base + 2, off & 0xFF);
-        write_byte(reg_base + 3, off >> 8);
-    }
+void I2c_PcA9685_Device::read_block(uint8_t reg, uint8_t *data, size_t len) {
+	if (_bus->write_read(&reg, 1, data, len, I2C_OP_READ_BLOCK) != 0) {
+		throw std::runtime_error("Failed to read I2C block");
+	}
+}
 
-void I2c_PcA9685::stop_all() {
-	_fd_set = _fd_servo;
-        for (uint8_t ch = 0; ch < 16; ++ch) {
-            set_pwm(ch, 0, 0);
-        }
-	_fd_set = _fd_mot;
-        for (uint8_t ch = 0; ch < 16; ++ch) {
-            set_pwm(ch, 0, 0);
-        }
+// Writes len bytes starting at reg in one transaction (needs MODE1 AI)
+int I2c_PcA9685_Device::write_block(uint8_t reg, const uint8_t *data, size_t len) noexcept {
+	uint8_t buffer[1 + 4 * PCA_CHANNELS];
+	if (len > sizeof(buffer) - 1)
+		return -EINVAL;
+	buffer[0] = reg;
+	memcpy(buffer + 1, data, len);
+	return _bus->write(buffer, len + 1, I2C_OP_SET_PWM);
+}
+
+// Throwing side of the PWM updates
+static void check_pwm(I2c_Status status) {
+	if (status.error() == I2c_Error::Range) {
+		throw std::runtime_error("PWM channel out of range");
+	}
+	if (!status) {
+		throw std::runtime_error("Failed to write I2C block");
+	}
+}
+
+void I2c_PcA9685_Device::set_pwm(uint8_t channel, uint16_t on, uint16_t off) {
+	set_pwm_burst(channel, &on, &off, 1);
     }
 
-void I2c_PcA9685::stop_motors() {
-	_fd_set = _fd_mot;
-        for (uint8_t ch = 0; ch < 8; ++ch) {
-            set_pwm_duty(ch, 0);
-        }
+// ON_L/ON_H/OFF_L/OFF_H of count contiguous channels in a single write
+int I2c_PcA9685_Device::write_pwm_burst(uint8_t channel, const uint16_t *on, const uint16_t *off, uint8_t count) noexcept {
+	uint8_t data[4 * PCA_CHANNELS];
+	if (channel + count > PCA_CHANNELS)
+		return -EINVAL;
+	for (uint8_t i = 0; i < count; ++i) {
+		data[4 * i]     = on[i] & 0xFF;
+		data[4 * i + 1] = on[i] >> 8;
+		data[4 * i + 2] = off[i] & 0xFF;
+		data[4 * i + 3] = off[i] >> 8;
+	}
+	return write_block(PCA_LED0_ON_L + 4 * channel, data, 4 * count);
+}
+
+// Records the new values in the shadow, marking only the channels that change
+void I2c_PcA9685_Device::stage_pwm(uint8_t channel, uint16_t on, uint16_t off) {
+	I2c_PcA9685_Shadow *sh = &_shadow;
+	uint16_t bit = 1u << channel;
+
+	if ((sh->valid & bit) && sh->on[channel] == on && sh->off[channel] == off)
+		return;
+	sh->on[channel] = on;
+	sh->off[channel] = off;
+	sh->dirty |= bit;
+}
+
+// Writes the dirty channels in as few bursts as pays off: a run goes on
+// across a clean gap whose bytes cost less than another transaction, as
+// long as the cache knows what those channels hold. Stops at the first
+// failure; the runs not written stay dirty.
+int I2c_PcA9685_Device::flush() noexcept {
+	I2c_PcA9685_Shadow *sh = &_shadow;
+	int ret;
+
+	while (sh->dirty) {
+		uint8_t first = __builtin_ctz(sh->dirty);
+		uint8_t last = first;
+
+		while (last + 1 < PCA_CHANNELS && (sh->dirty >> (last + 1))) {
+			uint8_t next = last + 1 + __builtin_ctz(sh->dirty >> (last + 1));
+			uint16_t gap = ((1u << next) - 1) & ~((1u << (last + 1)) - 1);
+
+			if (4 * (next - last - 1) >= PCA_TXN_OVERHEAD || (sh->valid & gap) != gap)
+				break;
+			last = next;
+		}
+		uint16_t run = ((1u << (last + 1)) - 1) & ~((1u << first) - 1);
+		if ((ret = write_pwm_burst(first, sh->on + first, sh->off + first, last + 1 - first)) != 0)
+			return ret;
+		sh->dirty &= ~run;
+		sh->valid |= run;
+	}
+	return 0;
+}
+
+int I2c_PcA9685_Device::update_pwm(uint8_t channel, const uint16_t *on, const uint16_t *off, uint8_t count) noexcept {
+	if (channel + count > PCA_CHANNELS)
+		return -EINVAL;
+	if (_stale.load(std::memory_order_relaxed) && _stale.exchange(false, std::memory_order_acquire))
+		invalidate_cache();
+	for (uint8_t i = 0; i < count; ++i)
+		stage_pwm(channel + i, on[i], off[i]);
+	return flush();
+}
+
+void I2c_PcA9685_Device::set_pwm_burst(uint8_t channel, const uint16_t *on, const uint16_t *off, uint8_t count) {
+	check_pwm(try_set_pwm_burst(channel, on, off, count));
+}
+
+I2c_Status I2c_PcA9685_Device::try_set_pwm_burst(uint8_t channel, const uint16_t *on, const uint16_t *off,
+						 uint8_t count) noexcept {
+	return I2c_Status::from_errno(update_pwm(channel, on, off, count));
+}
+
+// Forgets what the chip holds so the next update rewrites every channel
+void I2c_PcA9685_Device::invalidate_cache() {
+	_shadow = {};
+}
+
+void I2c_PcA9685_Device::stop_all() {
+	check_pwm(try_stop_all());
     }
 
-void I2c_PcA9685::set_pwm_duty(uint8_t channel, float duty_fraction) {
-    if (duty_fraction <= 0.0f) {
-        set_pwm(channel, 0, 0);
-    } else if (duty_fraction >= 1.0f) {
-        set_pwm(channel, 0, 4095);
-    } else {
-        uint16_t duty = static_cast<uint16_t>(duty_fraction * 4095);
-        set_pwm(channel, 0, duty);
+I2c_Status I2c_PcA9685_Device::try_stop_all() noexcept {
+	uint16_t zero[PCA_CHANNELS] = {0};
+
+	record(I2c_RecordCommand::StopAll);
+	_braking = false;
+	return try_set_pwm_burst(0, zero, zero, PCA_CHANNELS);
+}
+
+// Sets the full-off bit of every channel through ALL_LED_OFF_H: a single
+// two-byte write (about 0.3 ms at 100 kHz) that does not depend on MODE1 AI
+// or on what the cache believes. The OFF_L bytes are left as they were.
+void I2c_PcA9685_Device::emergency_stop() {
+	if (!try_emergency_stop()) {
+		throw std::runtime_error("Failed to write I2C byte");
+	}
+}
+
+I2c_Status I2c_PcA9685_Device::try_emergency_stop() noexcept {
+	int ret;
+
+	record(I2c_RecordCommand::EmergencyStop);
+	_braking = false;
+	if ((ret = emergency_stop(*_bus)) != 0)
+		return I2c_Status::from_errno(ret);
+	for (int ch = 0; ch < PCA_CHANNELS; ++ch)
+		_shadow.off[ch] = (_shadow.off[ch] & 0x00FF) | PCA_FULL_OFF;
+	_shadow.dirty = 0;
+	return I2c_Status();
+}
+
+// Same write on a bare transport, for a thread that does not own the device
+// (see I2c_Watchdog); returns 0 or -errno
+int I2c_PcA9685_Device::emergency_stop(I2c_Transport &bus) {
+	uint8_t buffer[2] = {PCA_ALL_LED_OFF_H, PCA_FULL_OFF >> 8};
+
+	return bus.write(buffer, 2, I2C_OP_EMERGENCY_STOP);
+}
+
+// Driver call into the flight recorder of the transport, if any
+void I2c_PcA9685_Device::record(I2c_RecordCommand cmd, int32_t a0, int32_t a1, int32_t a2, int32_t a3) noexcept {
+	I2c_Recorder *rec = _bus->recorder();
+
+	if (rec)
+		rec->command(_bus->recorder_device(), cmd, a0, a1, a2, a3);
+}
+
+// May be called from any thread: the owner drops its cache on its next update
+void I2c_PcA9685_Device::invalidate_cache_async() {
+	_stale.store(true, std::memory_order_release);
+}
+
+void I2c_PcA9685_Device::stop_motors() {
+	check_pwm(try_stop_motors());
     }
+
+I2c_Status I2c_PcA9685_Device::try_stop_motors() noexcept {
+	uint16_t zero[8] = {0};
+
+	record(I2c_RecordCommand::StopMotors);
+	_braking = false;
+	return try_set_pwm_burst(0, zero, zero, 8);
+}
+
+// Clamped with min/max instead of branches
+uint16_t I2c_PcA9685_Device::duty_to_pwm(float duty_fraction) {
+    float d = std::fmin(std::fmax(duty_fraction, 0.0f), 1.0f);
+    return static_cast<uint16_t>(d * (I2C_PCA9685_TICKS - 1));
 }
 
-uint16_t I2c_PcA9685::ms_to_pwm(float ms) {
+void I2c_PcA9685_Device::set_pwm_percent(uint8_t channel, int percent) {
+    set_pwm(channel, 0, I2c_DutyTable::percent(percent));
+}
+
+void I2c_PcA9685_Device::set_pwm_duty(uint8_t channel, float duty_fraction) {
+    set_pwm(channel, 0, duty_to_pwm(duty_fraction));
+}
+
+uint16_t I2c_PcA9685_Device::ms_to_pwm(float ms) {
         float pulse_length_us = 1000000.0f / _SERVO_FREQ / 4096.0f; // em us
         return static_cast<uint16_t>(ms * 1000.0f / pulse_length_us);
     }
 
-    // Converte ângulo 0-180 para pulso em ms, depois para PWM
-uint16_t I2c_PcA9685::angle_to_pwm(float angle) {
-        if (angle < 0.0f) angle = 0.0f;
-        if (angle > 180.0f) angle = 180.0f;
-        float pulse_ms = _SERVO_MIN_PULSE_MS + (angle / 180.0f) * (_SERVO_MAX_PULSE_MS - _SERVO_MIN_PULSE_MS);
-        return ms_to_pwm(pulse_ms);
+    // Ângulo 0-180 para PWM pela tabela do servo padrão
+uint16_t I2c_PcA9685_Device::angle_to_pwm(float angle) {
+        return I2c_ServoDefault::ticks(angle);
     }
 
-void I2c_PcA9685::set_servo_angle( float angle) {	
-	uint8_t channel  = 0;
-	_fd_set = _fd_servo;
-        uint16_t pwm = angle_to_pwm(angle);
-        set_pwm(channel, 0, pwm);
+void I2c_PcA9685_Device::set_servo_angle(uint8_t channel, float angle) {	
+        check_pwm(try_set_servo_angle(channel, angle));
     }
 
+I2c_Status I2c_PcA9685_Device::try_set_servo_angle(uint8_t channel, float angle) noexcept {
+	uint16_t on = 0;
+	uint16_t off = angle_to_pwm(angle);
+	int32_t bits;
+
+	memcpy(&bits, &angle, sizeof(bits));
+	record(I2c_RecordCommand::Servo, channel, bits);
 
-void I2c_PcA9685::motor(int mot,int seepd,bool dir)
+	return try_set_pwm_burst(channel, &on, &off, 1);
+}
+
+
+void I2c_PcA9685_Device::motor(int mot,int seepd,bool dir)
 {
-	_fd_set = _fd_mot;
-	
-	float dir_iv;
-	if(dir == 1)
-		dir_iv = 0.0;
-	else
-	 	dir_iv = 1;
-	
+	check_pwm(try_motor(mot, seepd, dir));
+}
 
-    	float adjusted_throttle = (float)seepd/100 * (float)1;
-        float duty = adjusted_throttle;
-	if (adjusted_throttle < 0.0f)
-        	 duty = -adjusted_throttle;
-	if(mot == 1)
-	{
-	set_pwm_duty(0, duty);  // Motor 1 speed
-        set_pwm_duty(1, dir);  // Direction 1
-        set_pwm_duty(2, dir_iv);  // Direction 2
-        set_pwm_duty(3, 0.0f);  // Motor 2 speed
+I2c_Status I2c_PcA9685_Device::try_motor(int mot,int seepd,bool dir) noexcept
+{
+	uint16_t duty = I2c_DutyTable::percent(seepd);
+	uint16_t fwd = dir ? I2C_PCA9685_TICKS - 1 : 0;
+	uint16_t rev = dir ? 0 : I2C_PCA9685_TICKS - 1;
+
+	bool braking = _braking;
+
+	record(I2c_RecordCommand::Motor, mot, seepd, dir);
+	_braking = false;  // a new command ends any brake in progress
+	uint16_t on[8] = {0};
+	uint16_t off[8] = {
+		duty,   // Motor 1 speed
+		fwd,    // Direction 1
+		rev,    // Direction 2
+		0,      // Motor 2 speed
+		duty,   // Motor 2 speed
+		rev,    // Direction 2
+		fwd,    // Direction 1
+		duty,   // Motor 2 speed
+	};
+	// The brake held both motors: the one not commanded is let coast,
+	// nothing would release it otherwise
+	if (braking && (mot == 1 || mot == 2)) {
+		for (int i = mot == 1 ? 4 : 0, end = i + 4; i < end; ++i)
+			off[i] = 0;
+		return try_set_pwm_burst(0, on, off, 8);
 	}
+	if(mot == 1)
+		return try_set_pwm_burst(0, on, off, 4);
 	if(mot == 2)
-	{
-        set_pwm_duty(4, duty);
-        set_pwm_duty(5, dir_iv);  // Direction 2
-        set_pwm_duty(6, dir);  // Direction 1
-        set_pwm_duty(7, duty);  // Motor 2 speed
-	}
+		return try_set_pwm_burst(4, on + 4, off + 4, 4);
 	if(mot == 0)
-	{
-	set_pwm_duty(0, duty);  // Motor 1 speed
-        set_pwm_duty(1, dir);  // Direction 1
-        set_pwm_duty(2, dir_iv);  // Direction 2
-        set_pwm_duty(3, 0.0f);  // Motor 2 speed
-        set_pwm_duty(4, duty);  // Motor 2 speed
-        set_pwm_duty(5, dir_iv);  // Direction 2
-        set_pwm_duty(6, dir);  // Direction 1
-        set_pwm_duty(7, duty);  // Motor 2 speed
+		return try_set_pwm_burst(0, on, off, 8);
+	return I2c_Status();
+}
+
+// Both sides of the H-bridges high (short brake) at percent of full duty
+void I2c_PcA9685_Device::apply_brake(int percent)
+{
+	uint16_t on[7] = {0};
+	uint16_t off[7];
+
+	for (int i = 0; i < 7; ++i)
+		off[i] = I2c_DutyTable::percent(percent);
+	set_pwm_burst(1, on, off, 7);
+}
+
+// Starts braking and returns at once; brake_update() moves it along the
+// profile and lets the motors coast once the duration is over
+void I2c_PcA9685_Device::brake_motor(const I2c_BrakeProfile &profile)
+{
+	_brake = profile;
+	// brake_update() scales it with unsigned math
+	_brake.intensity = profile.intensity < 0 ? 0 : (profile.intensity > 100 ? 100 : profile.intensity);
+	record(I2c_RecordCommand::Brake, (int32_t)_brake.mode, _brake.duration_us, _brake.intensity,
+	       _brake.pulse_us);
+	_brake_start = monotonic_ns();
+	_braking = true;
+	apply_brake(_brake.intensity);
+}
+
+void I2c_PcA9685_Device::brake_cancel()
+{
+	_braking = false;
+}
+
+// Returns when it next needs to run (CLOCK_MONOTONIC ns), 0 once idle
+uint64_t I2c_PcA9685_Device::brake_update()
+{
+	if (!_braking)
+		return 0;
+
+	uint64_t now = monotonic_ns();
+	uint64_t elapsed = now - _brake_start;
+	uint64_t duration = (uint64_t)_brake.duration_us * 1000;
+	uint64_t end = _brake_start + duration;
+	uint64_t next = end;
+
+	if (elapsed >= duration) {
+		_braking = false;
+		stop_motors();
+		return 0;
+	}
+	switch (_brake.mode) {
+	case I2c_BrakeMode::Constant:
+		break;
+	case I2c_BrakeMode::Pulsed: {
+		uint64_t pulse = _brake.pulse_us ? (uint64_t)_brake.pulse_us * 1000 : duration;
+		uint64_t n = elapsed / pulse;
+		apply_brake(n & 1 ? 0 : _brake.intensity);
+		next = _brake_start + (n + 1) * pulse;
+		break;
+	}
+	case I2c_BrakeMode::Proportional: {
+		uint64_t step = _brake.pulse_us ? (uint64_t)_brake.pulse_us * 1000 : duration;
+		apply_brake((int)(_brake.intensity * (duration - elapsed) / duration));
+		next = now + step;
+		break;
 	}
-	
+	}
+	return next < end ? next : end;
 }
 
-void I2c_PcA9685::brake_motor()
+// =============================================================================
+// Static API over the motor and servo boards
+// =============================================================================
+
+std::unique_ptr<I2c_PcA9685_Device> I2c_PcA9685::_mot;
+std::unique_ptr<I2c_PcA9685_Device> I2c_PcA9685::_servo;
+std::atomic<I2c_Watchdog *> I2c_PcA9685::_watchdog(nullptr);
+
+void I2c_PcA9685::init(uint8_t addr_mot, uint8_t addr_servo,std::string i2c_device, bool warm_start)
 {
-	float intensity = 1;
-        float duty = (intensity > 1.0f) ? 1.0f : (intensity < 0.0f ? 0.0f : intensity);
+	std::unique_ptr<I2c_Transport> mot(new I2c_DevTransport(i2c_device, addr_mot));
+	std::unique_ptr<I2c_Transport> servo(new I2c_DevTransport(i2c_device, addr_servo));
 
-        // Ambos os lados “altos” (equivale a curto virtual no driver)
-        set_pwm_duty(1, duty);
-        set_pwm_duty(2, duty);
-        set_pwm_duty(3, duty);
-        set_pwm_duty(4, duty);
-	set_pwm_duty(5, duty);
-        set_pwm_duty(6, duty);
-        set_pwm_duty(7, duty);
+	init(std::move(mot), std::move(servo), warm_start);
+}
 
-        usleep(100000); // 100 ms de frenagem ativa
+void I2c_PcA9685::init(std::unique_ptr<I2c_Transport> mot, std::unique_ptr<I2c_Transport> servo, bool warm_start)
+{
+	_mot.reset(new I2c_PcA9685_Device(std::move(mot)));
+	_servo.reset(new I2c_PcA9685_Device(std::move(servo)));
+	init_boards(*_mot, *_servo, warm_start);
+}
 
-        // Desliga tudo após frear
-        stop_motors();
+// Cold-starts both boards with one shared oscillator wait; with warm_start
+// a board that is already configured keeps running untouched
+void I2c_PcA9685::init_boards(I2c_PcA9685_Device &mot, I2c_PcA9685_Device &servo, bool warm_start)
+{
+	bool cold_mot = !(warm_start && mot.resume());
+	bool cold_servo = !(warm_start && servo.resume());
 
+	if (cold_mot)
+		mot.init_begin();
+	if (cold_servo)
+		servo.init_begin();
+	if (cold_mot)
+		mot.init_finish();
+	if (cold_servo)
+		servo.init_finish();
 }
 
-void I2c_PcA9685::end_motor_use()
+void I2c_PcA9685::stop_all()
 {
-	stop_motors();
-	close(_fd_set);
-	close(_fd_mot);
+	_servo->stop_all();
+	_mot->stop_all();
 }
 
+// Motors first: one write per board
+void I2c_PcA9685::emergency_stop()
+{
+	_mot->emergency_stop();
+	_servo->emergency_stop();
+}
 
+void I2c_PcA9685::stop_motors()
+{
+	_mot->stop_motors();
+}
 
+void I2c_PcA9685::watch(I2c_Watchdog *watchdog)
+{
+	_watchdog.store(watchdog, std::memory_order_release);
+}
+
+void I2c_PcA9685::heartbeat()
+{
+	I2c_Watchdog *watchdog = _watchdog.load(std::memory_order_acquire);
+
+	if (watchdog)
+		watchdog->kick();
+}
+
+void I2c_PcA9685::motor(int mot,int speed,bool dir)
+{
+	heartbeat();
+	_mot->motor(mot, speed, dir);
+}
+
+void I2c_PcA9685::set_servo_angle( float angle)
+{
+	_servo->set_servo_angle(0, angle);
+}
+
+I2c_Status I2c_PcA9685::try_motor(int mot, int speed, bool dir) noexcept
+{
+	heartbeat();
+	return _mot->try_motor(mot, speed, dir);
+}
+
+I2c_Status I2c_PcA9685::try_set_servo_angle(float angle) noexcept
+{
+	return _servo->try_set_servo_angle(0, angle);
+}
+
+I2c_Status I2c_PcA9685::try_stop_all() noexcept
+{
+	I2c_Status servo = _servo->try_stop_all();
+	I2c_Status mot = _mot->try_stop_all();
+
+	return mot ? servo : mot;
+}
+
+// Both boards are tried even if the first one fails
+I2c_Status I2c_PcA9685::try_emergency_stop() noexcept
+{
+	I2c_Status mot = _mot->try_emergency_stop();
+	I2c_Status servo = _servo->try_emergency_stop();
+
+	return mot ? servo : mot;
+}
+
+void I2c_PcA9685::brake_motor()
+{
+	uint64_t next;
+
+	_mot->brake_motor();
+	while ((next = _mot->brake_update()) != 0) {
+		struct timespec ts = {(time_t)(next / 1000000000ull), (long)(next % 1000000000ull)};
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+	}
+}
+
+void I2c_PcA9685::brake_motor(const I2c_BrakeProfile &profile)
+{
+	_mot->brake_motor(profile);
+}
+
+uint64_t I2c_PcA9685::brake_update()
+{
+	return _mot->brake_update();
+}
+
+void I2c_PcA9685::invalidate_cache()
+{
+	_mot->invalidate_cache();
+	_servo->invalidate_cache();
+}
+
+I2c_PcA9685_Device &I2c_PcA9685::motor_board()
+{
+	return *_mot;
+}
+
+I2c_PcA9685_Device &I2c_PcA9685::servo_board()
+{
+	return *_servo;
+}
+
+void I2c_PcA9685::end_motor_use()
+{
+	stop_motors();
+	_mot.reset();
+	_servo.reset();
+}
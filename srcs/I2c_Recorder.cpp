@@ -0,0 +1,216 @@
+#include "../include/I2c_Recorder.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REC_HEADER_SIZE	4096	// the ring starts on the second page
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+I2c_Recorder::I2c_Recorder(const std::string &path, uint64_t capacity)
+	: _fd(-1), _size(0), _header(nullptr), _ring(nullptr), _mask(capacity - 1)
+{
+	void *map;
+
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+		throw std::runtime_error("Recorder capacity must be a power of two");
+	_size = REC_HEADER_SIZE + capacity * sizeof(I2c_RecordEntry);
+	if ((_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+		throw std::runtime_error("Failed to create recorder file");
+	// Blocks allocated now, so writing a page later never hits ENOSPC
+	if (posix_fallocate(_fd, 0, _size) != 0 && ftruncate(_fd, _size) != 0) {
+		close(_fd);
+		throw std::runtime_error("Failed to size recorder file");
+	}
+	map = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, 0);
+	if (map == MAP_FAILED) {
+		close(_fd);
+		throw std::runtime_error("Failed to map recorder file");
+	}
+	_header = static_cast<I2c_RecorderHeader *>(map);
+	_ring = reinterpret_cast<I2c_RecordEntry *>(static_cast<char *>(map) + REC_HEADER_SIZE);
+
+	_header->record_size = sizeof(I2c_RecordEntry);
+	_header->clean = 0;
+	_header->capacity = capacity;
+	_header->created_realtime_ns = clock_ns(CLOCK_REALTIME);
+	_header->created_monotonic_ns = clock_ns(CLOCK_MONOTONIC);
+	_header->head.store(0, std::memory_order_relaxed);
+	// A file without its magic is one whose header never made it to disk
+	msync(_header, REC_HEADER_SIZE, MS_SYNC);
+	memcpy(_header->magic, I2C_RECORDER_MAGIC, sizeof(_header->magic));
+	msync(_header, REC_HEADER_SIZE, MS_SYNC);
+}
+
+I2c_Recorder::~I2c_Recorder()
+{
+	_header->clean = 1;
+	msync(_header, _size, MS_SYNC);
+	munmap(_header, _size);
+	close(_fd);
+}
+
+void I2c_Recorder::sync()
+{
+	msync(_header, _size, MS_SYNC);
+}
+
+// Reserves the next slot and invalidates it until the caller publishes seq
+I2c_RecordEntry &I2c_Recorder::claim(uint64_t &seq)
+{
+	uint64_t index = _header->head.fetch_add(1, std::memory_order_relaxed);
+	I2c_RecordEntry &e = _ring[index & _mask];
+
+	seq = index + 1;
+	__atomic_store_n(&e.seq, 0, __ATOMIC_RELAXED);
+	std::atomic_thread_fence(std::memory_order_release);
+	return e;
+}
+
+static void publish(I2c_RecordEntry &e, uint64_t seq)
+{
+	__atomic_store_n(&e.seq, seq, __ATOMIC_RELEASE);
+}
+
+// Writes become one record per I2C_RECORDER_DATA bytes, the register
+// advanced as auto-increment would; a write followed by a read is one Read
+void I2c_Recorder::transaction(uint8_t device, const struct i2c_msg *msgs, size_t count, int op, int status,
+			       uint64_t start_ns, uint64_t duration_ns)
+{
+	for (size_t i = 0; i < count; ++i) {
+		const struct i2c_msg &m = msgs[i];
+		bool read = i + 1 < count && !(m.flags & I2C_M_RD) && (msgs[i + 1].flags & I2C_M_RD) && m.len == 1;
+		const uint8_t *data = read ? msgs[i + 1].buf : m.buf + 1;
+		size_t len = read ? msgs[i + 1].len : (m.len ? m.len - 1 : 0);
+		uint8_t reg = m.len ? m.buf[0] : 0;
+		size_t off = 0;
+
+		do {
+			uint64_t seq;
+			I2c_RecordEntry &e = claim(seq);
+			size_t n = len - off < I2C_RECORDER_DATA ? len - off : I2C_RECORDER_DATA;
+
+			e.timestamp_ns = start_ns;
+			e.type = (uint8_t)(read ? I2c_RecordType::Read : I2c_RecordType::Write);
+			e.device = device;
+			e.reg = (uint8_t)(reg + off);
+			e.len = (uint8_t)n;
+			e.op = (uint8_t)op;
+			e.flags = 0;
+			e.status = (int16_t)status;
+			e.duration_ns = duration_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)duration_ns;
+			// A failed read has nothing worth keeping
+			if (!read || status == 0)
+				memcpy(e.data, data + off, n);
+			else
+				e.len = 0;
+			publish(e, seq);
+			off += n;
+		} while (off < len);
+		if (read)
+			++i;
+	}
+}
+
+void I2c_Recorder::command(uint8_t device, I2c_RecordCommand cmd, int32_t a0, int32_t a1, int32_t a2, int32_t a3)
+{
+	int32_t args[4] = {a0, a1, a2, a3};
+	uint64_t seq;
+	I2c_RecordEntry &e = claim(seq);
+
+	e.timestamp_ns = clock_ns(CLOCK_MONOTONIC);
+	e.type = (uint8_t)I2c_RecordType::Command;
+	e.device = device;
+	e.reg = (uint8_t)cmd;
+	e.len = sizeof(args);
+	e.op = 0;
+	e.flags = 0;
+	e.status = 0;
+	e.duration_ns = 0;
+	memcpy(e.data, args, sizeof(args));
+	publish(e, seq);
+}
+
+void I2c_Recorder::sample(uint8_t device, uint64_t timestamp_ns, const I2c_RecordSample &s)
+{
+	uint64_t seq;
+	I2c_RecordEntry &e = claim(seq);
+
+	static_assert(sizeof(I2c_RecordSample) <= I2C_RECORDER_DATA, "sample does not fit a record");
+	e.timestamp_ns = timestamp_ns;
+	e.type = (uint8_t)I2c_RecordType::Sample;
+	e.device = device;
+	e.reg = 0;
+	e.len = sizeof(s);
+	e.op = 0;
+	e.flags = 0;
+	e.status = 0;
+	e.duration_ns = 0;
+	memcpy(e.data, &s, sizeof(s));
+	publish(e, seq);
+}
+
+bool I2c_Recorder::load(const std::string &path, std::vector<I2c_RecordEntry> &out, I2c_RecorderHeader *header)
+{
+	struct stat st;
+	int fd;
+	void *map;
+	bool ok = false;
+
+	out.clear();
+	if ((fd = open(path.c_str(), O_RDONLY | O_CLOEXEC)) < 0)
+		return false;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < REC_HEADER_SIZE) {
+		close(fd);
+		return false;
+	}
+	map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return false;
+
+	const I2c_RecorderHeader *h = static_cast<const I2c_RecorderHeader *>(map);
+	const I2c_RecordEntry *ring = reinterpret_cast<const I2c_RecordEntry *>(static_cast<char *>(map) + REC_HEADER_SIZE);
+	uint64_t cap = h->capacity;
+
+	if (memcmp(h->magic, I2C_RECORDER_MAGIC, sizeof(h->magic)) == 0 && h->record_size == sizeof(I2c_RecordEntry)
+	    && cap && (cap & (cap - 1)) == 0 && REC_HEADER_SIZE + cap * sizeof(I2c_RecordEntry) <= (uint64_t)st.st_size) {
+		uint64_t head = h->head.load(std::memory_order_acquire);
+		uint64_t first = head > cap ? head - cap : 0;
+
+		out.reserve(head - first);
+		for (uint64_t i = first; i < head; ++i) {
+			const I2c_RecordEntry &e = ring[i & (cap - 1)];
+			I2c_RecordEntry copy;
+
+			// Checked before and after the copy in case the file is live
+			if (__atomic_load_n(&e.seq, __ATOMIC_ACQUIRE) != i + 1)
+				continue;
+			memcpy(&copy, &e, sizeof(copy));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (__atomic_load_n(&e.seq, __ATOMIC_RELAXED) == i + 1)
+				out.push_back(copy);
+		}
+		if (header) {
+			memcpy(header->magic, h->magic, sizeof(header->magic));
+			header->record_size = h->record_size;
+			header->clean = h->clean;
+			header->capacity = h->capacity;
+			header->created_realtime_ns = h->created_realtime_ns;
+			header->created_monotonic_ns = h->created_monotonic_ns;
+			header->head.store(head, std::memory_order_relaxed);
+		}
+		ok = true;
+	}
+	munmap(map, st.st_size);
+	return ok;
+}
@@ -0,0 +1,144 @@
+#include "../include/I2c_RtLoop.hpp"
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <time.h>
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static struct timespec to_timespec(uint64_t ns)
+{
+	struct timespec ts;
+	ts.tv_sec = ns / 1000000000ull;
+	ts.tv_nsec = ns % 1000000000ull;
+	return ts;
+}
+
+I2c_RtLoop::I2c_RtLoop(const I2c_RtConfig &config)
+	: _config(config), _run(false), _timer_fd(-1),
+	  _periods(0), _overruns(0), _misses(0), _errors(0)
+{
+	if (_config.period_ns == 0)
+		throw std::runtime_error("Invalid real-time loop period");
+	if ((_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0)
+		throw std::runtime_error("Failed to create real-time loop timerfd");
+}
+
+I2c_RtLoop::~I2c_RtLoop()
+{
+	stop();
+	close(_timer_fd);
+}
+
+void I2c_RtLoop::add(Callback callback)
+{
+	if (running())
+		throw std::runtime_error("Cannot add a callback to a running loop");
+	_callbacks.push_back(callback);
+}
+
+void I2c_RtLoop::reset_stats()
+{
+	_latency.reset();
+	_runtime.reset();
+	_periods = 0;
+	_overruns = 0;
+	_misses = 0;
+	_errors = 0;
+}
+
+void I2c_RtLoop::start()
+{
+	struct itimerspec its;
+	uint64_t start;
+	int err;
+
+	if (running())
+		return;
+	if (_config.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+		throw std::runtime_error(std::string("mlockall failed: ") + strerror(errno));
+
+	// First period one period from now, then strictly every period after it
+	start = monotonic_ns() + _config.period_ns;
+	its.it_value = to_timespec(start);
+	its.it_interval = to_timespec(_config.period_ns);
+	if (timerfd_settime(_timer_fd, TFD_TIMER_ABSTIME, &its, nullptr) < 0)
+		throw std::runtime_error("Failed to arm real-time loop timer");
+
+	_run = true;
+	_thread = std::thread(&I2c_RtLoop::loop, this, start);
+
+	if (_config.cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(_config.cpu, &set);
+		if ((err = pthread_setaffinity_np(_thread.native_handle(), sizeof(set), &set)) != 0) {
+			stop();
+			throw std::runtime_error(std::string("Failed to pin real-time loop: ") + strerror(err));
+		}
+	}
+	if (_config.priority > 0) {
+		struct sched_param param = {};
+		param.sched_priority = _config.priority;
+		if ((err = pthread_setschedparam(_thread.native_handle(), SCHED_FIFO, &param)) != 0) {
+			stop();
+			throw std::runtime_error(std::string("Failed to set SCHED_FIFO: ") + strerror(err));
+		}
+	}
+}
+
+// Returns within one period
+void I2c_RtLoop::stop()
+{
+	struct itimerspec its = {};
+
+	_run = false;
+	if (_thread.joinable())
+		_thread.join();
+	timerfd_settime(_timer_fd, 0, &its, nullptr);
+}
+
+void I2c_RtLoop::loop(uint64_t start)
+{
+	uint64_t index = 0;
+	uint64_t count;
+	I2c_RtTick tick;
+
+	while (_run.load(std::memory_order_relaxed)) {
+		if (read(_timer_fd, &count, sizeof(count)) != sizeof(count))
+			continue;
+		tick.wake = monotonic_ns();
+		// Only the latest expiration is served, the skipped ones are counted
+		index += count;
+		if (count > 1)
+			_overruns.fetch_add(count - 1, std::memory_order_relaxed);
+		tick.index = index - 1;
+		tick.release = start + tick.index * _config.period_ns;
+		tick.deadline = tick.release + _config.period_ns;
+		_latency.record(tick.wake - tick.release);
+
+		for (size_t i = 0; i < _callbacks.size(); ++i) {
+			try {
+				_callbacks[i](tick);
+			} catch (std::exception &e) {
+				_errors.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		uint64_t end = monotonic_ns();
+		_runtime.record(end - tick.wake);
+		if (end > tick.deadline)
+			_misses.fetch_add(1, std::memory_order_relaxed);
+		_periods.fetch_add(1, std::memory_order_relaxed);
+	}
+}
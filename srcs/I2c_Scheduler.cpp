@@ -0,0 +1,139 @@
+#include "../include/I2c_Scheduler.hpp"
+#include <time.h>
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+I2c_BusScheduler::I2c_BusScheduler()
+	: _busy(false), _seq(0), _splits(0)
+{
+	for (size_t i = 0; i < (size_t)I2c_BusClass::Count; ++i) {
+		_grants[i].store(0, std::memory_order_relaxed);
+		_late[i].store(0, std::memory_order_relaxed);
+	}
+	_waiting.reserve(16);
+}
+
+std::unique_ptr<I2c_Transport> I2c_BusScheduler::transport(std::unique_ptr<I2c_Transport> device, I2c_BusClass cls,
+							   int32_t budget_us)
+{
+	static const uint32_t defaults[(size_t)I2c_BusClass::Count] = {
+		I2C_SCHED_SAFETY_US, I2C_SCHED_ACTUATION_US, I2C_SCHED_TELEMETRY_US,
+	};
+	uint64_t budget = budget_us < 0 ? defaults[(size_t)cls] : (uint32_t)budget_us;
+
+	return std::unique_ptr<I2c_Transport>(new I2c_ScheduledTransport(*this, std::move(device), cls, budget * 1000));
+}
+
+// Free bus: taken at once. Otherwise queue up and sleep until release()
+// hands the bus over; there is no barging, so the order is the scheduler's.
+void I2c_BusScheduler::acquire(I2c_BusClass cls, uint64_t deadline)
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	Waiter w;
+
+	if (!_busy) {
+		_busy = true;
+		return;
+	}
+	w.cls = (uint8_t)cls;
+	w.deadline = deadline;
+	w.seq = _seq++;
+	w.granted = false;
+	_waiting.push_back(&w);
+	w.cv.wait(lock, [&w] { return w.granted; });
+}
+
+void I2c_BusScheduler::release()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	size_t best = 0;
+
+	if (_waiting.empty()) {
+		_busy = false;
+		return;
+	}
+	// Class, then deadline, then arrival
+	for (size_t i = 1; i < _waiting.size(); ++i) {
+		const Waiter *a = _waiting[i];
+		const Waiter *b = _waiting[best];
+		if (a->cls != b->cls) {
+			if (a->cls < b->cls)
+				best = i;
+		} else if (a->deadline != b->deadline) {
+			if (a->deadline < b->deadline)
+				best = i;
+		} else if (a->seq < b->seq) {
+			best = i;
+		}
+	}
+	Waiter *w = _waiting[best];
+	_waiting[best] = _waiting.back();
+	_waiting.pop_back();
+	// Under the lock: the waiter's frame is gone as soon as it sees granted
+	w->granted = true;
+	w->cv.notify_one();
+}
+
+int I2c_BusScheduler::run(I2c_Transport &device, struct i2c_msg *msgs, size_t count, I2c_BusClass cls,
+			  uint64_t deadline)
+{
+	uint64_t start = monotonic_ns();
+	uint64_t granted;
+	int ret;
+
+	acquire(cls, deadline);
+	granted = monotonic_ns();
+	ret = device.transfer(msgs, count);
+	release();
+
+	_wait[(size_t)cls].record(granted - start);
+	_grants[(size_t)cls].fetch_add(1, std::memory_order_relaxed);
+	if (granted > deadline)
+		_late[(size_t)cls].fetch_add(1, std::memory_order_relaxed);
+	return ret;
+}
+
+I2c_ScheduledTransport::I2c_ScheduledTransport(I2c_BusScheduler &scheduler, std::unique_ptr<I2c_Transport> device,
+					       I2c_BusClass cls, uint64_t budget_ns)
+	: _scheduler(scheduler), _device(std::move(device)), _class(cls), _budget_ns(budget_ns),
+	  _split(cls == I2c_BusClass::Telemetry)
+{
+}
+
+// The deadline is set once per call, so the pieces of a split
+// transaction keep the place of the whole
+int I2c_ScheduledTransport::transfer(struct i2c_msg *msgs, size_t count)
+{
+	uint64_t deadline = monotonic_ns() + _budget_ns;
+	size_t i = 0;
+	size_t pieces = 0;
+	int ret = 0;
+
+	// An emergency stop outranks the transport's own class
+	if (_op == I2C_OP_EMERGENCY_STOP && _class != I2c_BusClass::Safety) {
+		_metrics.count_syscalls(1);
+		return _scheduler.run(*_device, msgs, count, I2c_BusClass::Safety,
+				      monotonic_ns() + (uint64_t)I2C_SCHED_SAFETY_US * 1000);
+	}
+	if (!_split) {
+		_metrics.count_syscalls(1);
+		return _scheduler.run(*_device, msgs, count, _class, deadline);
+	}
+	while (i < count && ret == 0) {
+		// A pointer write stays with the read that follows it
+		size_t n = i + 1 < count && !(msgs[i].flags & I2C_M_RD) && (msgs[i + 1].flags & I2C_M_RD) ? 2 : 1;
+
+		_metrics.count_syscalls(1);
+		ret = _scheduler.run(*_device, msgs + i, n, _class, deadline);
+		i += n;
+		pieces++;
+	}
+	if (pieces > 1)
+		_scheduler.count_split();
+	return ret;
+}
@@ -0,0 +1,369 @@
+#include "../include/I2c_Sim.hpp"
+#include <chrono>
+#include <cstring>
+
+#define PCA_MODE1		0x00
+#define PCA_MODE2		0x01
+#define PCA_LED0_ON_L		0x06
+#define PCA_LED15_OFF_H		0x45
+#define PCA_ALL_LED_ON_L	0xFA
+#define PCA_ALL_LED_OFF_H	0xFD
+#define PCA_PRE_SCALE		0xFE
+
+#define PCA_MODE1_RESTART	0x80
+#define PCA_MODE1_AI		0x20
+#define PCA_MODE1_SLEEP		0x10
+
+#define INA_REG_CONFIG		0x00
+#define INA_REG_SHUNT_VOLTAGE	0x01
+#define INA_REG_BUS_VOLTAGE	0x02
+#define INA_REG_POWER		0x03
+#define INA_REG_CURRENT		0x04
+#define INA_REG_CALIBRATION	0x05
+
+#define INA_CONFIG_RST		0x8000
+#define INA_BUS_CNVR		0x0002
+#define INA_BUS_OVF		0x0001
+
+static uint64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// =============================================================================
+// PCA9685
+// =============================================================================
+
+I2c_SimPcA9685::I2c_SimPcA9685()
+{
+	reset();
+}
+
+// Power-on register values from the datasheet
+void I2c_SimPcA9685::reset()
+{
+	memset(_regs, 0, sizeof(_regs));
+	_regs[PCA_MODE1] = 0x11;
+	_regs[PCA_MODE2] = 0x04;
+	_regs[0x02] = 0xE2;
+	_regs[0x03] = 0xE4;
+	_regs[0x04] = 0xE8;
+	_regs[0x05] = 0xE0;
+	for (int ch = 0; ch < 16; ++ch)
+		_regs[PCA_LED0_ON_L + 4 * ch + 3] = 0x10;
+	_regs[PCA_PRE_SCALE] = 0x1E;
+	_ptr = 0;
+}
+
+void I2c_SimPcA9685::write_reg(uint8_t reg, uint8_t val)
+{
+	if (reg == PCA_MODE1) {
+		// RESTART is cleared by writing a one to it
+		_regs[reg] = val & ~PCA_MODE1_RESTART;
+	} else if (reg == PCA_PRE_SCALE) {
+		// Only writable while the oscillator is off
+		if (_regs[PCA_MODE1] & PCA_MODE1_SLEEP)
+			_regs[reg] = val < 3 ? 3 : val;
+	} else if (reg >= PCA_ALL_LED_ON_L && reg <= PCA_ALL_LED_OFF_H) {
+		for (int ch = 0; ch < 16; ++ch)
+			_regs[PCA_LED0_ON_L + 4 * ch + (reg - PCA_ALL_LED_ON_L)] = val;
+	} else if (reg <= PCA_LED15_OFF_H) {
+		_regs[reg] = val;
+	}
+	// 0x46-0xF9 are reserved, 0xFF is the test mode register
+}
+
+void I2c_SimPcA9685::write(const uint8_t *data, size_t len)
+{
+	if (len == 0)
+		return;
+	_ptr = data[0];
+	for (size_t i = 1; i < len; ++i) {
+		write_reg(_ptr, data[i]);
+		if (_regs[PCA_MODE1] & PCA_MODE1_AI)
+			++_ptr;
+	}
+}
+
+void I2c_SimPcA9685::read(uint8_t *data, size_t len)
+{
+	for (size_t i = 0; i < len; ++i) {
+		// ALL_LED registers always read back as zero
+		data[i] = (_ptr >= PCA_ALL_LED_ON_L && _ptr <= PCA_ALL_LED_OFF_H) ? 0 : _regs[_ptr];
+		if (_regs[PCA_MODE1] & PCA_MODE1_AI)
+			++_ptr;
+	}
+}
+
+uint16_t I2c_SimPcA9685::on(uint8_t channel) const
+{
+	const uint8_t *r = &_regs[PCA_LED0_ON_L + 4 * channel];
+	return r[0] | (r[1] << 8);
+}
+
+uint16_t I2c_SimPcA9685::off(uint8_t channel) const
+{
+	const uint8_t *r = &_regs[PCA_LED0_ON_L + 4 * channel];
+	return r[2] | (r[3] << 8);
+}
+
+bool I2c_SimPcA9685::full_off(uint8_t channel) const
+{
+	return off(channel) & 0x1000;
+}
+
+float I2c_SimPcA9685::duty(uint8_t channel) const
+{
+	uint16_t on_v = on(channel);
+	uint16_t off_v = off(channel);
+
+	if (off_v & 0x1000)
+		return 0.0f;
+	if (on_v & 0x1000)
+		return 1.0f;
+	int high = ((off_v & 0xFFF) - (on_v & 0xFFF) + 4096) % 4096;
+	return high / 4096.0f;
+}
+
+float I2c_SimPcA9685::frequency() const
+{
+	return 25000000.0f / (4096.0f * (_regs[PCA_PRE_SCALE] + 1));
+}
+
+bool I2c_SimPcA9685::sleeping() const
+{
+	return _regs[PCA_MODE1] & PCA_MODE1_SLEEP;
+}
+
+// =============================================================================
+// INA219
+// =============================================================================
+
+I2c_SimINA219::I2c_SimINA219() : _shunt_v(0), _bus_v(0)
+{
+	reset();
+}
+
+void I2c_SimINA219::reset()
+{
+	memset(_regs, 0, sizeof(_regs));
+	_regs[INA_REG_CONFIG] = 0x399F;
+	_ptr = 0;
+	_next_conv_ns = now_ns() + conversion_ns();
+}
+
+// Datasheet conversion times of one BADC/SADC setting, in ns
+static uint64_t adc_time_ns(unsigned code)
+{
+	static const uint64_t resolution[4] = {84000, 148000, 276000, 532000};
+	static const uint64_t averaging[8] = {532000, 1060000, 2130000, 4260000,
+					      8510000, 17020000, 34050000, 68100000};
+
+	if (code & 0x8)
+		return averaging[code & 0x7];
+	return resolution[code & 0x3];
+}
+
+uint64_t I2c_SimINA219::conversion_ns() const
+{
+	uint16_t config = _regs[INA_REG_CONFIG];
+	unsigned mode = config & 0x7;
+	uint64_t t = 0;
+
+	if (mode == 0 || mode == 4)
+		return 0;
+	if (mode & 0x1)
+		t += adc_time_ns((config >> 3) & 0xF);
+	if (mode & 0x2)
+		t += adc_time_ns((config >> 7) & 0xF);
+	return t;
+}
+
+// Latches the analog inputs and recomputes current/power as the chip does
+void I2c_SimINA219::convert()
+{
+	uint16_t config = _regs[INA_REG_CONFIG];
+	unsigned mode = config & 0x7;
+	bool ovf = false;
+
+	if (mode & 0x1) {
+		long range = 4000L << ((config >> 11) & 0x3);  // 40 mV * PGA gain, 10 uV LSB
+		long shunt = (long)(_shunt_v / 0.00001);
+		if (shunt > range) { shunt = range; ovf = true; }
+		if (shunt < -range) { shunt = -range; ovf = true; }
+		_regs[INA_REG_SHUNT_VOLTAGE] = (uint16_t)(int16_t)shunt;
+	}
+	if (mode & 0x2) {
+		long max = (config & 0x2000) ? 8000 : 4000;  // 32 V or 16 V, 4 mV LSB
+		long bus = (long)(_bus_v / 0.004);
+		if (bus < 0) bus = 0;
+		if (bus > max) bus = max;
+		_regs[INA_REG_BUS_VOLTAGE] = (uint16_t)(bus << 3);
+	}
+
+	long current = ((long)(int16_t)_regs[INA_REG_SHUNT_VOLTAGE] * _regs[INA_REG_CALIBRATION]) / 4096;
+	if (current > 32767) { current = 32767; ovf = true; }
+	if (current < -32768) { current = -32768; ovf = true; }
+	long power = ((current < 0 ? -current : current) * (long)(_regs[INA_REG_BUS_VOLTAGE] >> 3)) / 5000;
+	if (power > 0xFFFF) { power = 0xFFFF; ovf = true; }
+	_regs[INA_REG_CURRENT] = (uint16_t)(int16_t)current;
+	_regs[INA_REG_POWER] = (uint16_t)power;
+
+	_regs[INA_REG_BUS_VOLTAGE] = (_regs[INA_REG_BUS_VOLTAGE] & ~INA_BUS_OVF) | INA_BUS_CNVR
+		| (ovf ? INA_BUS_OVF : 0);
+}
+
+void I2c_SimINA219::update(uint64_t now)
+{
+	if (_next_conv_ns == 0 || now < _next_conv_ns)
+		return;
+	convert();
+	// Continuous modes (5-7) start the next conversion right away
+	if ((_regs[INA_REG_CONFIG] & 0x4) && conversion_ns())
+		_next_conv_ns = now + conversion_ns();
+	else
+		_next_conv_ns = 0;
+}
+
+void I2c_SimINA219::complete_conversion()
+{
+	if (_next_conv_ns == 0)
+		return;
+	_next_conv_ns = 1;
+	update(now_ns());
+}
+
+void I2c_SimINA219::set_inputs(double shunt_volts, double bus_volts)
+{
+	_shunt_v = shunt_volts;
+	_bus_v = bus_volts;
+}
+
+void I2c_SimINA219::write(const uint8_t *data, size_t len)
+{
+	if (len == 0)
+		return;
+	update(now_ns());
+	_ptr = data[0] < 6 ? data[0] : 0;
+	if (len < 3)
+		return;
+
+	uint16_t val = (data[1] << 8) | data[2];
+	if (_ptr == INA_REG_CONFIG) {
+		if (val & INA_CONFIG_RST) {
+			reset();
+			return;
+		}
+		// A config write aborts the current conversion and starts a new one
+		_regs[INA_REG_CONFIG] = val;
+		_regs[INA_REG_BUS_VOLTAGE] &= ~INA_BUS_CNVR;
+		uint64_t t = conversion_ns();
+		_next_conv_ns = t ? now_ns() + t : 0;
+	} else if (_ptr == INA_REG_CALIBRATION) {
+		_regs[INA_REG_CALIBRATION] = val & 0xFFFE;
+	}
+}
+
+void I2c_SimINA219::read(uint8_t *data, size_t len)
+{
+	update(now_ns());
+	uint16_t val = _regs[_ptr];
+	for (size_t i = 0; i < len; ++i)
+		data[i] = (i & 1) ? (val & 0xFF) : (val >> 8);
+	// Reading the power register clears the conversion ready flag
+	if (_ptr == INA_REG_POWER)
+		_regs[INA_REG_BUS_VOLTAGE] &= ~INA_BUS_CNVR;
+}
+
+// =============================================================================
+// Bus
+// =============================================================================
+
+I2c_SimBus::I2c_SimBus(uint32_t clock_hz)
+	: _clock_hz(clock_hz), _realtime(false), _read_last(false), _fail_count(0), _fail_errno(EREMOTEIO), _stats()
+{
+}
+
+void I2c_SimBus::attach(uint8_t addr, I2c_SimDevice *dev)
+{
+	std::lock_guard<std::mutex> guard(_lock);
+	_devices[addr] = dev;
+}
+
+void I2c_SimBus::detach(uint8_t addr)
+{
+	std::lock_guard<std::mutex> guard(_lock);
+	_devices.erase(addr);
+}
+
+std::unique_ptr<I2c_Transport> I2c_SimBus::transport(uint8_t addr)
+{
+	return std::unique_ptr<I2c_Transport>(new I2c_SimTransport(*this, addr));
+}
+
+void I2c_SimBus::inject_errors(unsigned count, int err)
+{
+	std::lock_guard<std::mutex> guard(_lock);
+	_fail_count = count;
+	_fail_errno = err;
+}
+
+I2c_SimStats I2c_SimBus::stats()
+{
+	std::lock_guard<std::mutex> guard(_lock);
+	return _stats;
+}
+
+void I2c_SimBus::reset_stats()
+{
+	std::lock_guard<std::mutex> guard(_lock);
+	_stats = I2c_SimStats();
+}
+
+int I2c_SimBus::transfer(uint8_t addr, struct i2c_msg *msgs, size_t count)
+{
+	std::lock_guard<std::mutex> guard(_lock);
+	uint64_t start = _realtime ? now_ns() : 0;
+	uint64_t bits = 1;  // STOP
+
+	if (_read_last)
+		for (size_t i = 0; i + 1 < count; ++i)
+			if (msgs[i].flags & I2C_M_RD)
+				return -EOPNOTSUPP;
+	_stats.transactions++;
+	for (size_t i = 0; i < count; ++i)
+		bits += 1 + 9 * (1 + msgs[i].len);  // (repeated) START, address, data + ACKs
+	uint64_t wire_ns = bits * 1000000000ull / _clock_hz;
+	_stats.bus_ns += wire_ns;
+
+	auto it = _devices.find(addr);
+	if (_fail_count > 0 || it == _devices.end()) {
+		int err = _fail_count > 0 ? _fail_errno : EREMOTEIO;
+		if (_fail_count > 0)
+			_fail_count--;
+		_stats.errors++;
+		return -err;
+	}
+	for (size_t i = 0; i < count; ++i) {
+		if (msgs[i].flags & I2C_M_RD)
+			it->second->read(msgs[i].buf, msgs[i].len);
+		else
+			it->second->write(msgs[i].buf, msgs[i].len);
+		_stats.messages++;
+		_stats.bytes += msgs[i].len;
+	}
+	if (_realtime)
+		while (now_ns() - start < wire_ns)
+			;
+	return 0;
+}
+
+int I2c_SimTransport::transfer(struct i2c_msg *msgs, size_t count)
+{
+	// Counted as the one syscall I2C_RDWR would take on real hardware
+	_metrics.count_syscalls(1);
+	for (size_t i = 0; i < count; ++i)
+		msgs[i].addr = _addr;
+	return _bus.transfer(_addr, msgs, count);
+}
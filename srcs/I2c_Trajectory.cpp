@@ -0,0 +1,266 @@
+#include "../include/I2c_Trajectory.hpp"
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cmath>
+#include <stdexcept>
+
+#define TRAJ_SERVO_UNSET	NAN	// no servo target yet
+
+// =============================================================================
+// Ramp
+// =============================================================================
+
+float I2c_Ramp::step(float target, float dt)
+{
+	float e = target - _value;
+
+	if (e == 0 && _rate == 0)
+		return _value;
+	if (_max_rate <= 0) {
+		reset(target);
+		return _value;
+	}
+	if (_max_accel <= 0) {
+		float d = _max_rate * dt;
+		if (std::fabs(e) <= d) {
+			reset(target);
+		} else {
+			_rate = std::copysign(_max_rate, e);
+			_value += _rate * dt;
+		}
+		return _value;
+	}
+
+	// Fastest rate from which the target can still be reached by braking
+	float want = std::copysign(std::fmin(_max_rate, std::sqrt(2 * _max_accel * std::fabs(e))), e);
+	float dv = _max_accel * dt;
+	float diff = want - _rate;
+
+	_rate += diff > dv ? dv : (diff < -dv ? -dv : diff);
+	_value += _rate * dt;
+	// Crossed the target: land on it rather than oscillate around it
+	if ((target - _value) * e <= 0)
+		reset(target);
+	return _value;
+}
+
+// =============================================================================
+// Trajectory
+// =============================================================================
+
+I2c_Trajectory::I2c_Trajectory(I2c_PcA9685_Device &mot, I2c_PcA9685_Device &servo, unsigned rate_hz)
+	: _mot(mot), _servo(servo), _period_ns(0), _timer_fd(-1), _wake_fd(-1),
+	  _run(true), _sleeping(true), _stop(false),
+	  _ticks(0), _updates(0), _overruns(0), _errors(0), _out_servo(0)
+{
+	if (rate_hz == 0)
+		throw std::runtime_error("Invalid trajectory rate");
+	_period_ns = 1000000000ull / rate_hz;
+	for (int i = 0; i < 2; ++i) {
+		_target[i].store(0);
+		_out_speed[i] = 0;
+	}
+	_target[2].store(TRAJ_SERVO_UNSET);
+	_ramp[2].reset(TRAJ_SERVO_UNSET);
+	_limit[0].store(200);  // motor: 0 to full in 0.5 s
+	_limit[1].store(0);
+	_limit[2].store(360);  // servo: end to end in 0.5 s
+	_limit[3].store(0);
+
+	if ((_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0)
+		throw std::runtime_error("Failed to create trajectory timerfd");
+	if ((_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+		close(_timer_fd);
+		throw std::runtime_error("Failed to create trajectory eventfd");
+	}
+	_thread = std::thread(&I2c_Trajectory::loop, this);
+}
+
+// Leaves the outputs where they are; stop the motors afterwards if needed
+I2c_Trajectory::~I2c_Trajectory()
+{
+	uint64_t one = 1;
+
+	_run = false;
+	if (write(_wake_fd, &one, sizeof(one)) < 0) {
+		// The thread still sees _run on its next tick
+	}
+	_thread.join();
+	close(_timer_fd);
+	close(_wake_fd);
+}
+
+void I2c_Trajectory::motor_limits(float accel, float jerk)
+{
+	_limit[0].store(accel);
+	_limit[1].store(jerk);
+	wake();
+}
+
+void I2c_Trajectory::servo_limits(float rate, float accel)
+{
+	_limit[2].store(rate);
+	_limit[3].store(accel);
+	wake();
+}
+
+void I2c_Trajectory::motor(int mot, int speed, bool dir)
+{
+	// Like I2c_PcA9685::motor(): the sign of speed is ignored, dir decides
+	float target = dir ? std::abs(speed) : -std::abs(speed);
+
+	I2c_PcA9685::heartbeat();
+	if (mot == 0 || mot == 1)
+		_target[0].store(target);
+	if (mot == 0 || mot == 2)
+		_target[1].store(target);
+	wake();
+}
+
+void I2c_Trajectory::set_servo_angle(float angle)
+{
+	_target[2].store(angle < 0.0f ? 0.0f : (angle > 180.0f ? 180.0f : angle));
+	wake();
+}
+
+void I2c_Trajectory::stop_motors()
+{
+	_target[0].store(0);
+	_target[1].store(0);
+	_stop.store(true);
+	wake();
+}
+
+// Only pays for the syscall when the thread went to sleep
+void I2c_Trajectory::wake()
+{
+	uint64_t one = 1;
+
+	if (_sleeping.exchange(false)) {
+		if (write(_wake_fd, &one, sizeof(one)) < 0)
+			_errors.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void I2c_Trajectory::arm(bool on)
+{
+	struct itimerspec its = {};
+
+	if (on) {
+		its.it_value.tv_sec = _period_ns / 1000000000ull;
+		its.it_value.tv_nsec = _period_ns % 1000000000ull;
+		its.it_interval = its.it_value;
+	}
+	if (timerfd_settime(_timer_fd, 0, &its, nullptr) < 0)
+		_errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool I2c_Trajectory::settled()
+{
+	for (int i = 0; i < 3; ++i) {
+		float target = _target[i].load();
+		if (i == 2 && std::isnan(target))
+			continue;
+		if (!_ramp[i].settled(target))
+			return false;
+	}
+	return !_stop.load();
+}
+
+// Advances every ramp by dt and writes what changed. True once settled.
+bool I2c_Trajectory::tick(float dt)
+{
+	int speed[2];
+
+	_ramp[0].configure(_limit[0].load(std::memory_order_relaxed), _limit[1].load(std::memory_order_relaxed));
+	_ramp[1].configure(_limit[0].load(std::memory_order_relaxed), _limit[1].load(std::memory_order_relaxed));
+	_ramp[2].configure(_limit[2].load(std::memory_order_relaxed), _limit[3].load(std::memory_order_relaxed));
+	if (_stop.exchange(false)) {
+		_ramp[0].reset(0);
+		_ramp[1].reset(0);
+		_out_speed[0] = _out_speed[1] = 1;  // force the write
+	}
+	for (int i = 0; i < 2; ++i)
+		speed[i] = (int)std::lround(_ramp[i].step(_target[i].load(), dt));
+
+	if (speed[0] != _out_speed[0] || speed[1] != _out_speed[1]) {
+		// The writes bypass I2c_PcA9685::motor(), which kicks the watchdog
+		I2c_PcA9685::heartbeat();
+		if (speed[0] == speed[1]) {
+			_mot.motor(0, std::abs(speed[0]), speed[0] >= 0);
+			_updates.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			for (int i = 0; i < 2; ++i) {
+				if (speed[i] == _out_speed[i])
+					continue;
+				_mot.motor(i + 1, std::abs(speed[i]), speed[i] >= 0);
+				_updates.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		_out_speed[0] = speed[0];
+		_out_speed[1] = speed[1];
+	}
+
+	float angle = _target[2].load();
+	if (!std::isnan(angle)) {
+		if (std::isnan(_ramp[2].value()))
+			_ramp[2].reset(angle);
+		uint16_t pwm = I2c_PcA9685_Device::angle_to_pwm(_ramp[2].step(angle, dt));
+		if (pwm != _out_servo) {
+			_servo.set_pwm(0, 0, pwm);
+			_updates.fetch_add(1, std::memory_order_relaxed);
+			_out_servo = pwm;
+		}
+	}
+	_ticks.fetch_add(1, std::memory_order_relaxed);
+	return settled();
+}
+
+void I2c_Trajectory::loop()
+{
+	struct pollfd fds[2] = {{_timer_fd, POLLIN, 0}, {_wake_fd, POLLIN, 0}};
+	float period = _period_ns / 1e9f;
+	bool armed = false;
+	uint64_t count;
+
+	while (_run.load(std::memory_order_relaxed)) {
+		bool done = false;
+
+		if (poll(fds, 2, -1) < 0)
+			continue;
+		try {
+			if (fds[1].revents & POLLIN) {
+				if (read(_wake_fd, &count, sizeof(count)) < 0) {
+					// Already drained
+				}
+				if (!armed) {
+					// Start a new run of ticks right away
+					arm(true);
+					armed = true;
+					done = tick(period);
+				}
+			}
+			if (fds[0].revents & POLLIN && read(_timer_fd, &count, sizeof(count)) == sizeof(count)) {
+				// Missed ticks are made up for in one longer step
+				if (count > 1)
+					_overruns.fetch_add(count - 1, std::memory_order_relaxed);
+				done = tick(period * count);
+			}
+		} catch (std::exception &e) {
+			_errors.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (!done)
+			continue;
+		// Announce the sleep, then look again so a target set meanwhile
+		// is not left behind
+		_sleeping.store(true);
+		if (!settled()) {
+			_sleeping.store(false);
+			continue;
+		}
+		arm(false);
+		armed = false;
+	}
+}
@@ -0,0 +1,165 @@
+#include "../include/I2c_Transport.hpp"
+#include "../include/I2c_Recorder.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+#include <stdexcept>
+#include <time.h>
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// A read before the last message
+static bool read_inside(const struct i2c_msg *msgs, size_t count)
+{
+	for (size_t i = 0; i + 1 < count; ++i)
+		if (msgs[i].flags & I2C_M_RD)
+			return true;
+	return false;
+}
+
+int I2c_Transport::send(struct i2c_msg *msgs, size_t count)
+{
+	size_t i = 0;
+	int ret = 0;
+
+	if (!read_inside(msgs, count))
+		return transfer(msgs, count);
+	if (!_split_reads) {
+		if ((ret = transfer(msgs, count)) != -EOPNOTSUPP)
+			return ret;
+		_split_reads = true;
+		ret = 0;
+	}
+	while (i < count && ret == 0) {
+		// A pointer write stays with the read that follows it
+		size_t n = i + 1 < count && !(msgs[i].flags & I2C_M_RD) && (msgs[i + 1].flags & I2C_M_RD) ? 2 : 1;
+
+		ret = transfer(msgs + i, n);
+		i += n;
+	}
+	return ret;
+}
+
+int I2c_Transport::transaction(struct i2c_msg *msgs, size_t count, I2c_Op op)
+{
+	uint64_t bytes = 0;
+	uint64_t start = monotonic_ns();
+	uint64_t backoff_ns = (uint64_t)_retry.backoff_us * 1000;
+	int ret;
+
+	_op = op;
+	ret = send(msgs, count);
+
+	for (uint8_t i = 0; i < _retry.retries && (ret == -EAGAIN || ret == -EREMOTEIO); ++i) {
+		if (backoff_ns) {
+			struct timespec ts = {(time_t)(backoff_ns / 1000000000ull), (long)(backoff_ns % 1000000000ull)};
+			nanosleep(&ts, nullptr);
+			backoff_ns *= 2;
+		}
+		_metrics.count_retry();
+		ret = send(msgs, count);
+	}
+
+	uint64_t elapsed = monotonic_ns() - start;
+
+	for (size_t i = 0; i < count; ++i)
+		bytes += msgs[i].len;
+	_metrics.record(op, elapsed, bytes, ret == 0);
+	if (_recorder)
+		_recorder->transaction(_recorder_device, msgs, count, op, ret, start, elapsed);
+	return ret;
+}
+
+int I2c_Transport::write(const uint8_t *data, size_t len, I2c_Op op)
+{
+	struct i2c_msg msg;
+
+	msg.addr = 0;
+	msg.flags = 0;
+	msg.len = len;
+	msg.buf = const_cast<uint8_t *>(data);
+	return transaction(&msg, 1, op);
+}
+
+int I2c_Transport::write_read(const uint8_t *wdata, size_t wlen, uint8_t *rdata, size_t rlen, I2c_Op op)
+{
+	struct i2c_msg msgs[2];
+
+	msgs[0].addr = 0;
+	msgs[0].flags = 0;
+	msgs[0].len = wlen;
+	msgs[0].buf = const_cast<uint8_t *>(wdata);
+	msgs[1].addr = 0;
+	msgs[1].flags = I2C_M_RD;
+	msgs[1].len = rlen;
+	msgs[1].buf = rdata;
+	return transaction(msgs, 2, op);
+}
+
+I2c_DevTransport::I2c_DevTransport(const std::string &i2c_device, uint8_t addr)
+	: _fd(-1), _addr(addr), _rdwr(false)
+{
+	if ((_fd = open(i2c_device.c_str(), O_RDWR)) < 0) {
+		throw std::runtime_error("Failed to open I2C device");
+	}
+	if (ioctl(_fd, I2C_SLAVE, addr) < 0) {
+		close(_fd);
+		throw std::runtime_error("Failed to set I2C address");
+	}
+
+	unsigned long funcs = 0;
+	_rdwr = ioctl(_fd, I2C_FUNCS, &funcs) == 0 && (funcs & I2C_FUNC_I2C);
+}
+
+I2c_DevTransport::~I2c_DevTransport()
+{
+	if (_fd >= 0)
+		close(_fd);
+}
+
+int I2c_DevTransport::transfer(struct i2c_msg *msgs, size_t count)
+{
+	// A single write is cheapest as plain write(); everything else goes
+	// through I2C_RDWR so the messages share one transaction
+	if (count == 1 && !(msgs[0].flags & I2C_M_RD)) {
+		_metrics.count_syscalls(1);
+		ssize_t n = ::write(_fd, msgs[0].buf, msgs[0].len);
+		if (n < 0)
+			return -errno;
+		return n == msgs[0].len ? 0 : -EIO;
+	}
+	if (_rdwr) {
+		struct i2c_rdwr_ioctl_data xfer;
+
+		for (size_t i = 0; i < count; ++i)
+			msgs[i].addr = _addr;
+		xfer.msgs = msgs;
+		xfer.nmsgs = count;
+		_metrics.count_syscalls(1);
+		int n = ioctl(_fd, I2C_RDWR, &xfer);
+		if (n < 0)
+			return -errno;
+		return n == (int)count ? 0 : -EIO;
+	}
+	// No combined transactions on this adapter: one syscall per message
+	for (size_t i = 0; i < count; ++i) {
+		ssize_t n;
+		_metrics.count_syscalls(1);
+		if (msgs[i].flags & I2C_M_RD)
+			n = ::read(_fd, msgs[i].buf, msgs[i].len);
+		else
+			n = ::write(_fd, msgs[i].buf, msgs[i].len);
+		if (n < 0)
+			return -errno;
+		if (n != msgs[i].len)
+			return -EIO;
+	}
+	return 0;
+}
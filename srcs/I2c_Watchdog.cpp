@@ -0,0 +1,106 @@
+#include "../include/I2c_Watchdog.hpp"
+#include "../include/I2c_Log.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <time.h>
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / 1000000000ull;
+	ts.tv_nsec = ns % 1000000000ull;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+		;
+}
+
+I2c_Watchdog::I2c_Watchdog(Action stop, uint32_t timeout_us, int priority)
+	: _stop(stop), _timeout_ns((uint64_t)timeout_us * 1000), _run(true),
+	  _last_kick(monotonic_ns()), _tripped(false), _trips(0), _errors(0)
+{
+	int err;
+
+	if (!_stop || timeout_us == 0)
+		throw std::runtime_error("Invalid watchdog action or timeout");
+	_thread = std::thread(&I2c_Watchdog::loop, this);
+	if (priority > 0) {
+		struct sched_param param = {};
+		param.sched_priority = priority;
+		if ((err = pthread_setschedparam(_thread.native_handle(), SCHED_FIFO, &param)) != 0) {
+			_run = false;
+			_thread.join();
+			throw std::runtime_error(std::string("Failed to set watchdog SCHED_FIFO: ") + strerror(err));
+		}
+	}
+}
+
+// Returns within one timeout
+I2c_Watchdog::~I2c_Watchdog()
+{
+	_run = false;
+	_thread.join();
+}
+
+void I2c_Watchdog::kick() noexcept
+{
+	_last_kick.store(monotonic_ns(), std::memory_order_release);
+}
+
+void I2c_Watchdog::loop()
+{
+	uint64_t tripped_at = 0;  // kick time the last trip was for
+
+	while (_run.load(std::memory_order_relaxed)) {
+		uint64_t last = _last_kick.load(std::memory_order_acquire);
+		uint64_t deadline = last + _timeout_ns;
+
+		if (_tripped.load(std::memory_order_relaxed)) {
+			if (last == tripped_at) {
+				// Stopped already, wait for the application to come back
+				sleep_until(monotonic_ns() + _timeout_ns);
+				continue;
+			}
+			_tripped.store(false, std::memory_order_release);
+		}
+		if (monotonic_ns() < deadline) {
+			sleep_until(deadline);
+			continue;  // a kick may have moved the deadline meanwhile
+		}
+
+		try {
+			_stop();
+		} catch (std::exception &) {
+			_errors.fetch_add(1, std::memory_order_relaxed);
+		}
+		uint64_t reaction = monotonic_ns() - deadline;
+		_reaction.record(reaction);
+		uint64_t trips = _trips.fetch_add(1, std::memory_order_relaxed) + 1;
+		I2c_Log::log(I2c_LogLevel::Warn, I2c_LogEvent::WatchdogTrip, 2, reaction, trips);
+		tripped_at = last;
+		_tripped.store(true, std::memory_order_release);
+	}
+}
+
+I2c_Watchdog::Action I2c_Watchdog::stop_board(I2c_PcA9685_Device &dev, std::unique_ptr<I2c_Transport> bus)
+{
+	std::shared_ptr<I2c_Transport> own(std::move(bus));
+	I2c_PcA9685_Device *target = &dev;
+
+	return [own, target]() {
+		int err = I2c_PcA9685_Device::emergency_stop(*own);
+		target->invalidate_cache_async();
+		if (err != 0)
+			throw std::runtime_error("Watchdog failed to stop the motors");
+	};
+}
@@ -0,0 +1,133 @@
+#include "../include/I2c.hpp"
+#include "../include/I2c_Sim.hpp"
+#include "../include/I2c_Trajectory.hpp"
+#include <cmath>
+#include <iostream>
+#include <time.h>
+#include <unistd.h>
+
+// Runs the drivers against the in-process simulator, no hardware needed.
+// Returns the number of failed checks.
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+		failures++; \
+	} \
+} while (0)
+
+#define CHECK_NEAR(a, b, eps) CHECK(std::fabs((double)(a) - (double)(b)) <= (eps))
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// The trajectory thread writes asynchronously: wait for its next update
+static void wait_updates(const I2c_Trajectory &traj, uint64_t updates)
+{
+	uint64_t end = monotonic_ns() + 1000000000ull;
+
+	while (traj.updates() < updates && monotonic_ns() < end)
+		usleep(1000);
+}
+
+int main()
+{
+	I2c_SimBus bus;
+	I2c_SimPcA9685 mot;
+	I2c_SimPcA9685 servo;
+	I2c_SimINA219 ina;
+
+	bus.attach(0x60, &mot);
+	bus.attach(0x40, &servo);
+	bus.attach(0x41, &ina);
+	bus.set_read_last_only(true);  // as the Pi's i2c-bcm2835 adapter
+	ina.set_inputs(0.05, 11.8);
+
+	I2c_PcA9685::init(bus.transport(0x60), bus.transport(0x40));
+	I2c_INA219::init(bus.transport(0x41));
+
+	// PRE_SCALE 121: 25 MHz / (4096 * 122)
+	CHECK(mot.reg(0xFE) == 121);
+	CHECK(servo.reg(0xFE) == 121);
+	CHECK_NEAR(mot.frequency(), 25e6 / (4096.0 * 122), 0.01);
+	CHECK(!mot.sleeping());
+	std::cout << "PWM frequency: " << mot.frequency() << " Hz" << std::endl;
+
+	// Each call is one burst: 8 channels of 4 bytes, then 1 channel
+	bus.reset_stats();
+	I2c::motor(0, 50, 1);
+	I2c_SimStats st = bus.stats();
+	CHECK(st.transactions == 1);
+	CHECK(st.bytes == 1 + 8 * 4);
+	I2c::set_servo_angle(90);
+	st = bus.stats();
+	CHECK(st.transactions == 2);
+	CHECK(st.bytes == 1 + 8 * 4 + 1 + 4);
+	std::cout << "motor + servo: " << st.transactions << " transactions, "
+		  << st.bytes << " bytes, " << st.bus_ns / 1000 << " us on the wire" << std::endl;
+
+	CHECK_NEAR(mot.duty(0), 0.5, 0.001);
+	CHECK_NEAR(mot.duty(4), 0.5, 0.001);
+	CHECK_NEAR(mot.duty(7), 0.5, 0.001);
+	CHECK(mot.duty(1) > 0.99 && mot.duty(2) == 0);
+	// 1.5 ms of a 19.99 ms period
+	CHECK(servo.off(0) == 307);
+	CHECK(I2c_PcA9685_Device::angle_to_pwm(90) == 307);
+	std::cout << "motor 1 duty: " << mot.duty(0) << ", servo pulse: "
+		  << servo.off(0) << " ticks" << std::endl;
+
+	{
+		// Same arguments as I2c::motor(): a negative speed keeps dir
+		I2c_Trajectory traj(I2c::motor_board(), I2c::servo_board());
+		traj.motor_limits(0, 0);  // no ramp
+		traj.motor(1, -40, 1);
+		wait_updates(traj, 1);
+		CHECK_NEAR(mot.duty(0), 0.4, 0.001);
+		CHECK(mot.duty(1) > 0.99 && mot.duty(2) == 0);
+		traj.motor(1, 40, 0);
+		wait_updates(traj, 2);
+		CHECK_NEAR(mot.duty(0), 0.4, 0.001);
+		CHECK(mot.duty(1) == 0 && mot.duty(2) > 0.99);
+	}
+
+	// Default calibration: 100 uA current LSB, 2 mW power LSB. Each
+	// register is its own pointer write + read on this adapter.
+	ina.complete_conversion();
+	bus.reset_stats();
+	I2c_INA219_Sample s = I2c_INA219::device().update();
+	CHECK(bus.stats().transactions == 4);
+	CHECK(s.bus_uv == 11800000);
+	CHECK(s.shunt_uv == 50000);
+	CHECK(s.current_ua == 500000);
+	CHECK(s.power_uw == 5900000);
+	CHECK_NEAR(s.voltage, 11.8, 1e-9);
+	CHECK_NEAR(s.shunt_voltage, 0.05, 1e-9);
+	CHECK_NEAR(s.current, 500, 1e-9);
+	CHECK_NEAR(s.power, 5900, 1e-9);
+	CHECK(s.raw.ready() && !s.raw.overflow());
+	I2c::print();
+
+	// Emergency stop: one ALL_LED_OFF_H write per board
+	bus.reset_stats();
+	I2c_PcA9685::emergency_stop();
+	st = bus.stats();
+	CHECK(st.transactions == 2);
+	CHECK(st.bytes == 2 * 2);
+	for (int ch = 0; ch < 16; ++ch) {
+		CHECK(mot.full_off(ch));
+		CHECK(servo.full_off(ch));
+	}
+
+	I2c::stop_all();
+	I2c::end_motor_use();
+	I2c_INA219::close_();
+	if (failures)
+		std::cerr << failures << " check(s) failed" << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,219 @@
+#include "../include/I2c.hpp"
+#include "../include/I2c_Sim.hpp"
+#include "../include/I2c_Scheduler.hpp"
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Transport, INA219 read paths and bus scheduler on the simulator.
+// Returns the number of failed checks.
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+		failures++; \
+	} \
+} while (0)
+
+static uint64_t monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Logs the first byte of every write; the HOLD write keeps the bus busy.
+// It sleeps rather than spins so the other threads get to queue up.
+#define HOLD 0xAA
+
+class OrderDevice : public I2c_SimDevice
+{
+	public:
+		std::vector<uint8_t> order;  // under the sim bus lock
+
+		void write(const uint8_t *data, size_t len) override
+		{
+			if (len == 0)
+				return;
+			order.push_back(data[0]);
+			if (data[0] == HOLD)
+				usleep(50000);
+		}
+
+		void read(uint8_t *data, size_t len) override
+		{
+			for (size_t i = 0; i < len; ++i)
+				data[i] = 0;
+		}
+};
+
+// EAGAIN/EREMOTEIO retried up to the policy with a doubling backoff,
+// anything else returned at once
+static void test_retry()
+{
+	static I2c_MetricsSnapshot m;
+	I2c_SimBus bus;
+	I2c_SimPcA9685 pca;
+	uint8_t mode2[2] = {0x01, 0x04};
+
+	bus.attach(0x60, &pca);
+	std::unique_ptr<I2c_Transport> t = bus.transport(0x60);
+
+	bus.inject_errors(2);
+	CHECK(t->write(mode2, 2) == 0);
+	CHECK(pca.reg(0x01) == 0x04);
+	t->metrics().snapshot(m);
+	CHECK(m.retries == 2);
+	CHECK(m.syscalls == 3);
+	CHECK(m.transactions() == 1);
+	CHECK(bus.stats().errors == 2);
+
+	bus.inject_errors(3);
+	CHECK(t->write(mode2, 2) == -EREMOTEIO);
+	bus.inject_errors(1, EAGAIN);
+	CHECK(t->write(mode2, 2) == 0);
+	t->metrics().snapshot(m);
+	CHECK(m.retries == 5);
+
+	bus.inject_errors(1, EIO);
+	CHECK(t->write(mode2, 2) == -EIO);
+	t->metrics().snapshot(m);
+	CHECK(m.retries == 5);
+
+	I2c_RetryPolicy policy;
+	policy.retries = 2;
+	policy.backoff_us = 2000;
+	t->set_retry_policy(policy);
+	bus.inject_errors(2);
+	uint64_t start = monotonic_ns();
+	CHECK(t->write(mode2, 2) == 0);
+	CHECK(monotonic_ns() - start >= 6000000);  // 2 ms, then 4 ms
+}
+
+// A read in the middle of a transaction: -EOPNOTSUPP once, then one
+// pointer write + read per transaction
+static void test_split_reads()
+{
+	static I2c_MetricsSnapshot m;
+	I2c_SimBus bus;
+	I2c_SimINA219 ina;
+	uint8_t regs[2] = {0x01, 0x02};
+	uint8_t data[2][2];
+	struct i2c_msg msgs[4] = {
+		{0, 0, 1, &regs[0]}, {0, I2C_M_RD, 2, data[0]},
+		{0, 0, 1, &regs[1]}, {0, I2C_M_RD, 2, data[1]},
+	};
+
+	bus.attach(0x41, &ina);
+	ina.set_inputs(0.05, 11.8);
+	ina.complete_conversion();
+	std::unique_ptr<I2c_Transport> t = bus.transport(0x41);
+
+	CHECK(t->transaction(msgs, 4) == 0);
+	CHECK(!t->split_reads());
+	CHECK(bus.stats().transactions == 1);
+
+	bus.set_read_last_only(true);
+	bus.reset_stats();
+	memset(data, 0, sizeof(data));
+	CHECK(t->transaction(msgs, 4) == 0);
+	CHECK(t->split_reads());
+	CHECK(bus.stats().transactions == 2);
+	CHECK(((data[0][0] << 8) | data[0][1]) == ina.reg(0x01));
+	CHECK(((data[1][0] << 8) | data[1][1]) == ina.reg(0x02));
+	t->metrics().snapshot(m);
+	CHECK(m.transactions() == 2);
+	CHECK(m.retries == 0);
+}
+
+// read_raw_if_ready() reads only the bus voltage register until CNVR is set
+static void test_cnvr()
+{
+	I2c_SimBus bus;
+	I2c_SimINA219 ina;
+	I2c_INA219_Raw raw;
+	I2c_INA219_Config cfg;
+
+	bus.attach(0x41, &ina);
+	ina.set_inputs(0.05, 11.8);
+	I2c_INA219_Device dev(bus.transport(0x41));
+	cfg.bus_adc = I2c_INA219_Adc::Avg128;  // 136 ms: no conversion ends on its own here
+	dev.init(cfg);
+
+	bus.reset_stats();
+	CHECK(!dev.read_raw_if_ready(raw));
+	CHECK(bus.stats().transactions == 1);
+
+	ina.complete_conversion();
+	bus.reset_stats();
+	CHECK(dev.read_raw_if_ready(raw));
+	CHECK(bus.stats().transactions == 2);
+	CHECK(raw.ready());
+	CHECK(raw.bus >> 3 == 2950);
+	CHECK(raw.shunt == 5000);
+	CHECK(raw.current == 5000);
+	CHECK(raw.power == 2950);
+
+	// Reading the power register cleared CNVR
+	bus.reset_stats();
+	CHECK(!dev.read_raw_if_ready(raw));
+	CHECK(bus.stats().transactions == 1);
+}
+
+// Queued behind a transaction on the wire: class first, then deadline.
+// An emergency stop runs as Safety whatever its transport's class.
+static void test_scheduler()
+{
+	I2c_SimBus bus;
+	OrderDevice dev;
+	I2c_BusScheduler sched;
+	uint8_t hold = HOLD;
+	uint8_t tel = 0x01;
+	uint8_t tel_short = 0x02;
+	uint8_t act = 0x03;
+	uint8_t estop = 0x04;
+
+	bus.attach(0x60, &dev);
+	std::unique_ptr<I2c_Transport> t_hold = sched.transport(bus.transport(0x60), I2c_BusClass::Telemetry);
+	std::unique_ptr<I2c_Transport> t_tel = sched.transport(bus.transport(0x60), I2c_BusClass::Telemetry);
+	std::unique_ptr<I2c_Transport> t_short = sched.transport(bus.transport(0x60), I2c_BusClass::Telemetry, 100);
+	std::unique_ptr<I2c_Transport> t_act = sched.transport(bus.transport(0x60), I2c_BusClass::Actuation);
+	std::unique_ptr<I2c_Transport> t_estop = sched.transport(bus.transport(0x60), I2c_BusClass::Actuation);
+
+	std::thread th_hold([&] { t_hold->write(&hold, 1); });
+	usleep(5000);
+	std::thread th_tel([&] { t_tel->write(&tel, 1); });
+	usleep(2000);
+	std::thread th_act([&] { t_act->write(&act, 1); });
+	usleep(2000);
+	std::thread th_short([&] { t_short->write(&tel_short, 1); });
+	usleep(2000);
+	std::thread th_estop([&] { t_estop->write(&estop, 1, I2C_OP_EMERGENCY_STOP); });
+	th_hold.join();
+	th_tel.join();
+	th_act.join();
+	th_short.join();
+	th_estop.join();
+
+	std::vector<uint8_t> expected = {hold, estop, act, tel_short, tel};
+	CHECK(dev.order == expected);
+	CHECK(sched.grants(I2c_BusClass::Safety) == 1);
+	CHECK(sched.grants(I2c_BusClass::Actuation) == 1);
+	CHECK(sched.grants(I2c_BusClass::Telemetry) == 3);
+}
+
+int main()
+{
+	test_retry();
+	test_split_reads();
+	test_cnvr();
+	test_scheduler();
+	if (failures)
+		std::cerr << failures << " check(s) failed" << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+#include "../include/I2c.hpp"
+#include "../include/I2c_Sim.hpp"
+#include "../include/I2c_Recorder.hpp"
+#include "../include/I2c_Telemetry.hpp"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// History ring, window statistics and flight recorder on the simulator.
+// Returns the number of failed checks.
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+		failures++; \
+	} \
+} while (0)
+
+#define CHECK_NEAR(a, b, eps) CHECK(std::fabs((double)(a) - (double)(b)) <= (eps))
+
+// The view never holds the slot the next push() writes into
+static void test_ring()
+{
+	I2c_RingBuffer<int, 8> ring;
+	I2c_Span<int> first, second;
+	uint64_t seq;
+
+	seq = ring.view(first, second);
+	CHECK(seq == 0 && first.size == 0 && second.size == 0);
+
+	for (int i = 0; i < 5; ++i)
+		ring.push(i);
+	seq = ring.view(first, second);
+	CHECK(seq == 0);
+	CHECK(ring.size() == 5);
+	CHECK(first.size == 5 && second.size == 0);
+	CHECK(first[0] == 0 && first[4] == 4);
+	CHECK(!ring.overwritten(seq));
+
+	for (int i = 5; i < 8; ++i)
+		ring.push(i);
+	seq = ring.view(first, second);
+	CHECK(seq == 1);
+	CHECK(ring.size() == 7);
+	CHECK(first.size + second.size == 7);
+	CHECK(first[0] == 1);
+	CHECK(!ring.overwritten(seq));
+	CHECK(ring.overwritten(0));
+
+	// Wrapped: oldest part at the end of the array, newest at the start
+	for (int i = 8; i < 13; ++i)
+		ring.push(i);
+	seq = ring.view(first, second);
+	CHECK(seq == 6);
+	CHECK(first.size == 2 && second.size == 5);
+	int expect = 6;
+	bool in_order = true;
+	for (int v : first)
+		in_order &= v == expect++;
+	for (int v : second)
+		in_order &= v == expect++;
+	CHECK(in_order && expect == 13);
+	CHECK(!ring.overwritten(seq));
+
+	// The next push reuses the oldest item's slot
+	ring.push(13);
+	CHECK(ring.overwritten(seq));
+	CHECK(!ring.overwritten(seq + 1));
+}
+
+static void test_window_stats()
+{
+	I2c_WindowStats<8> w;
+	I2c_Stats st;
+
+	st = w.stats();
+	CHECK(st.count == 0);
+
+	w.configure(4, 0.5);
+	for (int i = 1; i <= 5; ++i)
+		w.push(i);
+	st = w.stats();
+	CHECK(st.count == 4);
+	CHECK(st.min == 2 && st.max == 5);
+	CHECK_NEAR(st.mean, 3.5, 1e-12);
+	CHECK_NEAR(st.variance, 5.0 / 3.0, 1e-12);
+	CHECK_NEAR(st.ewma, 4.0625, 1e-12);
+
+	// The maximum leaves the window, the minimum arrives
+	for (int i = 0; i < 4; ++i)
+		w.push(i == 3 ? -1 : 3);
+	st = w.stats();
+	CHECK(st.count == 4);
+	CHECK(st.min == -1 && st.max == 3);
+	CHECK_NEAR(st.mean, 2, 1e-12);
+}
+
+// Published samples feed the device's ring and statistics
+static void test_ina219_history()
+{
+	I2c_SimBus bus;
+	I2c_SimINA219 ina;
+	I2c_Span<I2c_INA219_Sample> first, second;
+
+	bus.attach(0x41, &ina);
+	I2c_INA219_Device dev(bus.transport(0x41));
+	dev.init();
+	dev.configure_stats(2, 0.5);
+	for (int i = 0; i < 3; ++i) {
+		ina.set_inputs(0.01 * (i + 1), 11 + i);
+		ina.complete_conversion();
+		dev.update();
+	}
+
+	uint64_t seq = dev.history(first, second);
+	CHECK(seq == 0);
+	CHECK(first.size + second.size == 3);
+	CHECK(first.size == 3 && first[0].bus_uv == 11000000 && first[2].bus_uv == 13000000);
+	CHECK(!dev.history_overwritten(seq));
+
+	I2c_INA219_Stats st = dev.stats();
+	CHECK(st.voltage.count == 2);
+	CHECK_NEAR(st.voltage.min, 12, 1e-9);
+	CHECK_NEAR(st.voltage.max, 13, 1e-9);
+	CHECK_NEAR(st.current.mean, 250, 0.1);   // 200 and 300 mA, within the 0.1 mA LSB
+}
+
+static const I2c_RecordEntry *find(const std::vector<I2c_RecordEntry> &records, I2c_RecordType type,
+				   uint8_t device, uint8_t reg)
+{
+	for (const I2c_RecordEntry &e : records)
+		if (e.type == (uint8_t)type && e.device == device && e.reg == reg)
+			return &e;
+	return nullptr;
+}
+
+// What the drivers record comes back from the file as written
+static void test_recorder()
+{
+	std::string path = "sim_telemetry_" + std::to_string(getpid()) + ".rec";
+	std::vector<I2c_RecordEntry> records;
+	I2c_RecorderHeader header;
+	I2c_SimBus bus;
+	I2c_SimPcA9685 pca;
+	I2c_SimINA219 ina;
+
+	bus.attach(0x60, &pca);
+	bus.attach(0x41, &ina);
+	ina.set_inputs(0.05, 11.8);
+	{
+		I2c_Recorder rec(path, 64);
+		I2c_PcA9685_Device mot(bus.transport(0x60));
+		I2c_INA219_Device sensor(bus.transport(0x41));
+
+		mot.init();
+		sensor.init();
+		mot.set_recorder(&rec, 0x60);
+		sensor.set_recorder(&rec, 0x41);
+		mot.motor(0, 50, 1);
+		ina.complete_conversion();
+		sensor.update();
+		CHECK(rec.recorded() > 0);
+		CHECK(rec.capacity() == 64);
+		rec.sync();
+
+		CHECK(I2c_Recorder::load(path, records, &header));
+		CHECK(records.size() == rec.recorded());
+	}
+	CHECK(!strcmp(header.magic, I2C_RECORDER_MAGIC));
+	CHECK(header.capacity == 64);
+	CHECK(header.record_size == sizeof(I2c_RecordEntry));
+
+	bool seq_ok = true;
+	for (size_t i = 0; i < records.size(); ++i)
+		seq_ok &= records[i].seq == i + 1;
+	CHECK(seq_ok);
+
+	const I2c_RecordEntry *cmd = find(records, I2c_RecordType::Command, 0x60, (uint8_t)I2c_RecordCommand::Motor);
+	CHECK(cmd != nullptr);
+	if (cmd) {
+		int32_t args[3];
+		memcpy(args, cmd->data, sizeof(args));
+		CHECK(args[0] == 0 && args[1] == 50 && args[2] == 1);
+	}
+
+	// LED0_ON_L burst: 8 channels of 4 bytes, as on the sim chip
+	const I2c_RecordEntry *w = find(records, I2c_RecordType::Write, 0x60, 0x06);
+	CHECK(w != nullptr);
+	if (w) {
+		CHECK(w->len == 32 && w->status == 0);
+		CHECK(w->op == I2C_OP_SET_PWM);
+		CHECK(((w->data[3] << 8) | w->data[2]) == pca.off(0));
+	}
+
+	const I2c_RecordEntry *r = find(records, I2c_RecordType::Read, 0x41, 0x02);
+	CHECK(r != nullptr);
+	if (r)
+		CHECK(r->len == 2 && ((r->data[0] << 8) | r->data[1]) >> 3 == 2950);
+
+	const I2c_RecordEntry *smp = find(records, I2c_RecordType::Sample, 0x41, 0);
+	CHECK(smp != nullptr);
+	if (smp) {
+		I2c_RecordSample s;
+		memcpy(&s, smp->data, sizeof(s));
+		CHECK(s.bus_uv == 11800000 && s.shunt_uv == 50000);
+		CHECK(s.current_ua == 500000 && s.power_uw == 5900000);
+	}
+	unlink(path.c_str());
+}
+
+int main()
+{
+	test_ring();
+	test_window_stats();
+	test_ina219_history();
+	test_recorder();
+	if (failures)
+		std::cerr << failures << " check(s) failed" << std::endl;
+	return failures ? 1 : 0;
+}